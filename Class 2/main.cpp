@@ -5,6 +5,14 @@
 #include <string>
 #include <cctype>
 #include <algorithm>
+#include <map>
+#include <set>
+#include <climits>
+#include <cstdio>
+#include <iomanip>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
 
 using namespace std;
 
@@ -82,14 +90,137 @@ string cppType(const string& t) {
     if (t == "string")  return "std::string";
     return t;
 }
+string cType(const string& t) {
+    if (t == "integer") return "int";
+    if (t == "float")   return "float";
+    if (t == "string")  return "const char*";
+    return t;
+}
+bool isStringLiteral(const string& s) { return s.size() >= 2 && s.front() == '"' && s.back() == '"'; }
+
+// A number literal read the way the C++ compiler reads the emitted code:
+// decimal, octal (leading 0), hex (0x) and binary (0b) integers that fit in
+// int, and decimal floating literals (double), exponent allowed. Anything
+// else (suffixes, wider integers, bad digits) returns false, so a backend
+// that has to interpret the literal itself never guesses.
+struct NumLiteral {
+    bool isFloat = false;
+    long long i = 0;      // !isFloat
+    double d = 0;         // isFloat
+};
+
+bool parseNumLiteral(const string& t, NumLiteral& out) {
+    auto digitsIn = [&](size_t from, size_t to, int base) {
+        if (from >= to) return false;
+        long long v = 0;
+        for (size_t k = from; k < to; ++k) {
+            int c = tolower(static_cast<unsigned char>(t[k]));
+            int d = isdigit(c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : base;
+            if (d >= base) return false;
+            v = v * base + d;
+            if (v > INT_MAX) return false;
+        }
+        out.isFloat = false; out.i = v;
+        return true;
+    };
+    if (t.empty() || !isdigit(static_cast<unsigned char>(t[0]))) return false;
+    if (t.size() > 1 && t[0] == '0' && (t[1] == 'x' || t[1] == 'X')) return digitsIn(2, t.size(), 16);
+    if (t.size() > 1 && t[0] == '0' && (t[1] == 'b' || t[1] == 'B')) return digitsIn(2, t.size(), 2);
+
+    // digits ['.' digits] [('e' | 'E') ['+' | '-'] digits]
+    size_t k = 0;
+    while (k < t.size() && isdigit(static_cast<unsigned char>(t[k]))) ++k;
+    size_t intEnd = k;
+    bool isFloat = false;
+    if (k < t.size() && t[k] == '.') {
+        isFloat = true;
+        ++k;
+        while (k < t.size() && isdigit(static_cast<unsigned char>(t[k]))) ++k;
+    }
+    if (k < t.size() && (t[k] == 'e' || t[k] == 'E')) {
+        isFloat = true;
+        ++k;
+        if (k < t.size() && (t[k] == '+' || t[k] == '-')) ++k;
+        size_t expStart = k;
+        while (k < t.size() && isdigit(static_cast<unsigned char>(t[k]))) ++k;
+        if (k == expStart) return false;
+    }
+    if (k != t.size()) return false;
+    if (isFloat) {
+        out.isFloat = true; out.d = strtod(t.c_str(), nullptr);
+        return true;
+    }
+    if (t[0] == '0' && intEnd > 1) return digitsIn(1, intEnd, 8);
+    return digitsIn(0, intEnd, 10);
+}
+
+// The spelling of the number literal starting at toks[k], put back together:
+// the tokenizer splits 6.5 into "6" "." "5" and 1e-3 into "1e" "-" "3".
+// Returns how many tokens the literal spans. A sign is only taken into the
+// literal when that makes it a valid exponent; hex digits never do.
+size_t readNumLiteral(const vector<string>& toks, size_t k, string& lit) {
+    auto startsWithDigit = [&](size_t j) {
+        return j < toks.size() && !toks[j].empty() && isdigit(static_cast<unsigned char>(toks[j][0]));
+    };
+    lit = toks[k];
+    size_t n = 1;
+    if (k + n < toks.size() && toks[k+n] == "." && startsWithDigit(k+n+1)) {
+        lit += "." + toks[k+n+1];
+        n += 2;
+    }
+    if ((lit.back() == 'e' || lit.back() == 'E') && k + n < toks.size()
+        && (toks[k+n] == "+" || toks[k+n] == "-") && startsWithDigit(k+n+1)) {
+        NumLiteral probe;
+        string withExp = lit + toks[k+n] + toks[k+n+1];
+        if (parseNumLiteral(withExp, probe)) {
+            lit = withExp;
+            n += 2;
+        }
+    }
+    return n;
+}
+
+// ---------- Program model ----------
+// An expression keeps its raw tokens next to the joined text, so backends
+// that need more than copy-paste (types, folding, ...) can re-read it.
+struct Expr {
+    vector<string> toks;
+    string text;
+};
+
+struct Stmt {
+    enum Kind { Decl, Print, ArrayDecl, Loop, Call } kind;
+    string type;          // Decl/ArrayDecl: integer / float / string
+    string id;            // Decl: variable name, ArrayDecl: array name, Call: helper name
+    Expr value;           // Decl: initializer
+    vector<Expr> args;    // Print/Loop: dekhao(...) arguments, Call: actual parameters
+    vector<string> elems; // ArrayDecl: literal initializers
+    int count = 0;        // Loop: iterations of the dekhao in args
+};
+
+// An outlined dekhao: `args` are written over the parameter names
+struct Helper {
+    string name;
+    vector<pair<string, string>> params;   // (type keyword, parameter name)
+    vector<Expr> args;
+};
+
+struct Program {
+    vector<Stmt> stmts;
+    vector<Helper> helpers;
+    bool usesString = false;
+    bool usesFloat  = false;
+};
 
 // Consume until end of line or EOF; join tokens as expression
-string readExprUntilEOL(const vector<string>& tok, size_t& i) {
+Expr readExprUntilEOL(const vector<string>& tok, size_t& i) {
+    Expr e;
     ostringstream oss;
     while (i < tok.size() && !isNewlineToken(tok[i])) {
         // skip nothing; we want raw expression, but ignore stray "te" if any
         if (tok[i] == "te") { ++i; continue; }
         oss << tok[i];
+        e.toks.push_back(tok[i]);
         // Add spacing between identifiers/numbers/strings to avoid accidental merging,
         // but no spaces around operators or parentheses
         if (i + 1 < tok.size() && !isNewlineToken(tok[i+1])) {
@@ -97,7 +228,7 @@ string readExprUntilEOL(const vector<string>& tok, size_t& i) {
             bool needSpace = false;
             // Add space if both current and next are "word-like" or strings
             auto wordLike = [](const string& s){
-                if (s.size() >= 2 && s.front()=='"' && s.back()=='"') return true; // string literal
+                if (isStringLiteral(s)) return true; // string literal
                 return !s.empty() && (isalnum(static_cast<unsigned char>(s[0])) || s[0]=='_');
             };
             if (wordLike(tok[i]) && wordLike(next)) needSpace = true;
@@ -105,28 +236,31 @@ string readExprUntilEOL(const vector<string>& tok, size_t& i) {
         }
         ++i;
     }
-    return oss.str();
+    e.text = oss.str();
+    return e;
 }
 
 // Split dekhao(...) args by top-level commas
-vector<string> splitArgs(const vector<string>& tok, size_t& i) {
-    vector<string> args;
+vector<Expr> splitArgs(const vector<string>& tok, size_t& i) {
+    vector<Expr> args;
     int depth = 0;
     ostringstream cur;
+    vector<string> curToks;
 
     auto flushArg = [&](){
         string s = cur.str();
         // trim
         s.erase(s.begin(), find_if(s.begin(), s.end(), [](unsigned char c){return !isspace(c);} ));
         s.erase(find_if(s.rbegin(), s.rend(), [](unsigned char c){return !isspace(c);} ).base(), s.end());
-        if (!s.empty()) args.push_back(s);
+        if (!s.empty()) args.push_back({curToks, s});
         cur.str(""); cur.clear();
+        curToks.clear();
     };
 
     // Expect '(' already consumed, now gather until matching ')'
     while (i < tok.size()) {
         const string& t = tok[i];
-        if (t == "(") { depth++; cur << t; }
+        if (t == "(") { depth++; cur << t; curToks.push_back(t); }
         else if (t == ")") {
             if (depth == 0) { // end of arg list
                 flushArg();
@@ -135,11 +269,13 @@ vector<string> splitArgs(const vector<string>& tok, size_t& i) {
             } else {
                 depth--;
                 cur << t;
+                curToks.push_back(t);
             }
         } else if (t == "," && depth == 0) {
             flushArg();
         } else if (!isNewlineToken(t)) {
             cur << t;
+            curToks.push_back(t);
             // spacing heuristic for readability
             if (i+1 < tok.size()) {
                 const string& nxt = tok[i+1];
@@ -154,14 +290,9 @@ vector<string> splitArgs(const vector<string>& tok, size_t& i) {
     return args;
 }
 
-// ---------- Parser / Transpiler ----------
-string transpile(const vector<string>& tok) {
-    ostringstream out;
-    bool usesString = false;
-    bool usesFloat  = false;
-
-    // We'll emit a minimal C++ program
-    vector<string> body;
+// ---------- Parser ----------
+Program parseProgram(const vector<string>& tok) {
+    Program prog;
 
     // Parse line-by-line using newline tokens as separators
     size_t i = 0;
@@ -177,17 +308,12 @@ string transpile(const vector<string>& tok) {
             // next should be "("
             if (i < tok.size() && tok[i] == "(") {
                 ++i;
-                auto args = splitArgs(tok, i); // consumes up to ')'
+                Stmt s;
+                s.kind = Stmt::Print;
+                s.args = splitArgs(tok, i); // consumes up to ')'
                 // Consume until end of line
                 while (i < tok.size() && !isNewlineToken(tok[i])) ++i;
-
-                ostringstream stmt;
-                stmt << "std::cout";
-                for (auto &a : args) {
-                    stmt << " << " << a;
-                }
-                stmt << " << std::endl;";
-                body.push_back(stmt.str());
+                prog.stmts.push_back(s);
             } else {
                 // malformed; skip to EOL
                 while (i < tok.size() && !isNewlineToken(tok[i])) ++i;
@@ -195,19 +321,18 @@ string transpile(const vector<string>& tok) {
         }
         else if (i+3 < tok.size() && isTypeKeyword(tok[i])) {
             // <type> <id> te <expr...>
-            string tkw = tok[i++]; // type keyword
-            string id  = (i < tok.size() ? tok[i++] : "");
+            Stmt s;
+            s.kind = Stmt::Decl;
+            s.type = tok[i++]; // type keyword
+            s.id   = (i < tok.size() ? tok[i++] : "");
             string maybeTe = (i < tok.size() ? tok[i] : "");
             if (maybeTe == "te") ++i; // consume 'te'
 
-            string expr = readExprUntilEOL(tok, i);
-
-            if (tkw == "string") usesString = true;
-            if (tkw == "float")  usesFloat  = true;
+            s.value = readExprUntilEOL(tok, i);
 
-            ostringstream stmt;
-            stmt << cppType(tkw) << " " << id << " = " << expr << ";";
-            body.push_back(stmt.str());
+            if (s.type == "string") prog.usesString = true;
+            if (s.type == "float")  prog.usesFloat  = true;
+            prog.stmts.push_back(s);
         }
         else {
             // Unrecognized line: just skip to EOL
@@ -217,20 +342,1403 @@ string transpile(const vector<string>& tok) {
         // consume trailing newlines between statements
         while (i < tok.size() && isNewlineToken(tok[i])) ++i;
     }
+    return prog;
+}
+
+// Static type of an expression: string wins over float, float over integer.
+// Good enough for the backends that cannot lean on C++ overloading.
+string exprType(const Expr& e, const map<string, string>& vars) {
+    bool isFloat = false;
+    for (size_t k = 0; k < e.toks.size(); ++k) {
+        const string& t = e.toks[k];
+        if (isStringLiteral(t)) return "string";
+        if (isdigit(static_cast<unsigned char>(t[0]))) {
+            string lit;
+            k += readNumLiteral(e.toks, k, lit) - 1;
+            NumLiteral value;
+            if (parseNumLiteral(lit, value) && value.isFloat) isFloat = true;
+            continue;
+        }
+        auto it = vars.find(t);
+        if (it != vars.end()) {
+            if (it->second == "string") return "string";
+            if (it->second == "float") isFloat = true;
+        }
+    }
+    return isFloat ? "float" : "integer";
+}
+
+// ---------- Loop rerolling ----------
+// Generated scripts often look like
+//     integer v1 te 1          dekhao(v1)
+//     integer v2 te 2    ...   dekhao(v2)
+// Runs of such declarations become one array (ArrayDecl), and runs of
+// dekhao that differ only in integer literals / array indices progressing
+// by a constant step become one Loop. The printed output is unchanged.
+static const char* kLoopVar = "rr_k";
+
+// Same spacing rule as readExprUntilEOL
+string joinTokens(const vector<string>& toks) {
+    auto wordLike = [](const string& s){
+        return !s.empty() && (isalnum(static_cast<unsigned char>(s[0])) || s[0]=='_' || s[0]=='"');
+    };
+    string out;
+    for (size_t k = 0; k < toks.size(); ++k) {
+        if (k > 0 && wordLike(toks[k-1]) && wordLike(toks[k])) out += ' ';
+        out += toks[k];
+    }
+    return out;
+}
+
+// Any integer literal C++ accepts as an int: 10, 010, 0x10, 0b10
+bool isIntLiteral(const string& t) {
+    NumLiteral lit;
+    return parseNumLiteral(t, lit) && !lit.isFloat;
+}
+
+// Value of a literal isIntLiteral accepted, optionally preceded by "-"
+long long intLiteralValue(const string& t) {
+    NumLiteral lit;
+    bool neg = !t.empty() && t[0] == '-';
+    parseNumLiteral(neg ? t.substr(1) : t, lit);
+    return neg ? -lit.i : lit.i;
+}
+
+bool isDigits(const string& t) {
+    return !t.empty() && all_of(t.begin(), t.end(), [](unsigned char c){ return isdigit(c); });
+}
+
+// "v12" -> ("v", 12); false when the name has no numeric suffix
+bool splitCounter(const string& id, string& prefix, long long& k) {
+    size_t p = id.size();
+    while (p > 0 && isdigit(static_cast<unsigned char>(id[p-1]))) --p;
+    if (p == 0 || p == id.size() || id.size() - p > 9) return false;
+    prefix = id.substr(0, p);
+    k = stoll(id.substr(p));
+    return true;
+}
+
+// Initializer that is a single (possibly negative) number
+bool literalInitializer(const Stmt& s, string& lit) {
+    const auto& t = s.value.toks;
+    size_t k = 0;
+    lit.clear();
+    if (k < t.size() && t[k] == "-") { lit = "-"; ++k; }
+    if (k >= t.size() || !isIntLiteral(t[k])) return false;
+    lit += t[k++];
+    if (s.type == "float" && k + 1 < t.size() && t[k] == "." && isDigits(t[k+1])) { lit += "." + t[k+1]; k += 2; }
+    return k == t.size();
+}
+
+struct ArraySlot { string array; int index; };
+
+class Reroller {
+public:
+    explicit Reroller(size_t minRun) : minRun(minRun) {}
+
+    Program run(const Program& in) {
+        Program out = in;
+        out.stmts.clear();
+        const auto& st = in.stmts;
+        for (size_t i = 0; i < st.size(); ) {
+            size_t n = declRun(st, i);
+            if (n >= minRun) { out.stmts.push_back(makeArray(st, i, n)); i += n; continue; }
+            if (st[i].kind == Stmt::Print) {
+                vector<Stmt> prints;
+                size_t j = i;
+                while (j < st.size() && st[j].kind == Stmt::Print) prints.push_back(rewrite(st[j++]));
+                emitPrints(prints, out.stmts);
+                i = j;
+                continue;
+            }
+            out.stmts.push_back(rewrite(st[i++]));
+        }
+        return out;
+    }
+
+private:
+    size_t minRun;
+    map<string, ArraySlot> slots;   // rerolled variable -> array element
+    int arrays = 0;
+
+    // Length of the run of literal declarations v<k0>, v<k0+d>, ... at i
+    size_t declRun(const vector<Stmt>& st, size_t i) const {
+        string prefix, p, lit;
+        long long k0, k1, k;
+        if (st[i].kind != Stmt::Decl || st[i].type == "string" || !literalInitializer(st[i], lit)
+            || !splitCounter(st[i].id, prefix, k0)) return 0;
+        if (i + 1 >= st.size() || st[i+1].kind != Stmt::Decl || st[i+1].type != st[i].type
+            || !literalInitializer(st[i+1], lit) || !splitCounter(st[i+1].id, p, k1) || p != prefix || k1 == k0) return 1;
+        size_t n = 2;
+        while (i + n < st.size()) {
+            const Stmt& s = st[i+n];
+            if (s.kind != Stmt::Decl || s.type != st[i].type || !literalInitializer(s, lit)
+                || !splitCounter(s.id, p, k) || p != prefix || k != k0 + (long long)n * (k1 - k0)) break;
+            ++n;
+        }
+        return n;
+    }
+
+    Stmt makeArray(const vector<Stmt>& st, size_t i, size_t n) {
+        Stmt a;
+        a.kind = Stmt::ArrayDecl;
+        a.type = st[i].type;
+        a.id = "rr" + to_string(arrays++) + "_" + st[i].id.substr(0, st[i].id.find_last_not_of("0123456789") + 1);
+        for (size_t j = 0; j < n; ++j) {
+            string lit;
+            literalInitializer(st[i+j], lit);
+            a.elems.push_back(lit);
+            slots[st[i+j].id] = {a.id, (int)j};
+        }
+        return a;
+    }
+
+    // Rewrites references to rerolled variables into array elements
+    Expr rewrite(const Expr& e) const {
+        Expr r;
+        for (auto& t : e.toks) {
+            auto it = slots.find(t);
+            if (it == slots.end()) { r.toks.push_back(t); continue; }
+            for (const string& part : {it->second.array, string("["), to_string(it->second.index), string("]")})
+                r.toks.push_back(part);
+        }
+        r.text = (r.toks == e.toks) ? e.text : joinTokens(r.toks);
+        return r;
+    }
+
+    Stmt rewrite(const Stmt& s) const {
+        Stmt r = s;
+        r.value = rewrite(s.value);
+        for (auto& a : r.args) a = rewrite(a);
+        return r;
+    }
+
+    // Integer literal positions that may vary across a run (not part of a
+    // float: neither side of a "." nor the exponent of 1e-3, "1e" "-" "3")
+    static bool varyingPosition(const vector<string>& toks, size_t k) {
+        if (!isIntLiteral(toks[k])) return false;
+        if (k > 0 && toks[k-1] == ".") return false;
+        if (k + 1 < toks.size() && toks[k+1] == ".") return false;
+        if (k > 1 && (toks[k-1] == "-" || toks[k-1] == "+")) {
+            const string& m = toks[k-2];
+            if (isdigit(static_cast<unsigned char>(m[0])) && (m.back() == 'e' || m.back() == 'E')) return false;
+        }
+        return true;
+    }
+
+    // True if b has a's shape: same tokens except varying integer literals
+    static bool sameShape(const Stmt& a, const Stmt& b) {
+        if (a.args.size() != b.args.size()) return false;
+        for (size_t x = 0; x < a.args.size(); ++x) {
+            const auto& ta = a.args[x].toks;
+            const auto& tb = b.args[x].toks;
+            if (ta.size() != tb.size()) return false;
+            for (size_t k = 0; k < ta.size(); ++k)
+                if (ta[k] != tb[k] && !(varyingPosition(ta, k) && isIntLiteral(tb[k]))) return false;
+        }
+        return true;
+    }
+
+    static long long literalAt(const Stmt& s, size_t x, size_t k) { return intLiteralValue(s.args[x].toks[k]); }
+
+    // Groups a block of consecutive dekhao into Loops where possible
+    void emitPrints(const vector<Stmt>& prints, vector<Stmt>& out) const {
+        for (size_t i = 0; i < prints.size(); ) {
+            size_t n = 1;
+            if (i + 1 < prints.size() && sameShape(prints[i], prints[i+1])) {
+                n = 2;
+                while (i + n < prints.size() && sameShape(prints[i], prints[i+n]) && progresses(prints, i, n)) ++n;
+            }
+            if (n < minRun) { out.push_back(prints[i++]); continue; }
+
+            Stmt loop;
+            loop.kind = Stmt::Loop;
+            loop.count = (int)n;
+            for (size_t x = 0; x < prints[i].args.size(); ++x) {
+                const auto& t0 = prints[i].args[x].toks;
+                Expr body;
+                for (size_t k = 0; k < t0.size(); ++k) {
+                    if (!varyingPosition(t0, k) || t0[k] == prints[i+1].args[x].toks[k]) { body.toks.push_back(t0[k]); continue; }
+                    long long v0 = literalAt(prints[i], x, k), step = literalAt(prints[i+1], x, k) - v0;
+                    vector<string> idx = {"(", to_string(v0), "+", kLoopVar, "*", to_string(step), ")"};
+                    if (v0 == 0 && step == 1) idx = {kLoopVar};
+                    body.toks.insert(body.toks.end(), idx.begin(), idx.end());
+                }
+                body.text = joinTokens(body.toks);
+                loop.args.push_back(body);
+            }
+            out.push_back(loop);
+            i += n;
+        }
+    }
+
+    // prints[i+n] continues the arithmetic progression set by prints[i], prints[i+1]
+    static bool progresses(const vector<Stmt>& prints, size_t i, size_t n) {
+        const Stmt& a = prints[i];
+        for (size_t x = 0; x < a.args.size(); ++x) {
+            const auto& t0 = a.args[x].toks;
+            for (size_t k = 0; k < t0.size(); ++k) {
+                if (!varyingPosition(t0, k)) continue;
+                long long v0 = literalAt(a, x, k), step = literalAt(prints[i+1], x, k) - v0;
+                long long v = v0 + (long long)n * step;
+                if (v < 0 || v > INT_MAX || literalAt(prints[i+n], x, k) != v) return false;
+            }
+        }
+        return true;
+    }
+};
+
+Program reroll(const Program& prog, size_t minRun = 8) { return Reroller(minRun).run(prog); }
+
+// Array elements: an integer progression is filled by a loop, anything
+// else is a constant table
+bool intProgression(const Stmt& a, long long& start, long long& step) {
+    if (a.type != "integer" || a.elems.size() < 2) return false;
+    start = intLiteralValue(a.elems[0]);
+    step = intLiteralValue(a.elems[1]) - start;
+    for (size_t j = 2; j < a.elems.size(); ++j)
+        if (intLiteralValue(a.elems[j]) != start + (long long)j * step) return false;
+    return true;
+}
+
+string arrayDeclCode(const Stmt& a, const string& elemType) {
+    ostringstream out;
+    long long start, step;
+    if (intProgression(a, start, step)) {
+        out << "    " << elemType << " " << a.id << "[" << a.elems.size() << "];\n";
+        out << "    for (int " << kLoopVar << " = 0; " << kLoopVar << " < " << a.elems.size() << "; ++" << kLoopVar << ") "
+            << a.id << "[" << kLoopVar << "] = " << start << " + " << kLoopVar << " * " << step << ";\n";
+    } else {
+        out << "    static const " << elemType << " " << a.id << "[" << a.elems.size() << "] = {";
+        for (size_t j = 0; j < a.elems.size(); ++j) {
+            if (j % 16 == 0) out << "\n        ";
+            out << a.elems[j] << ",";
+        }
+        out << "\n    };\n";
+    }
+    return out.str();
+}
+
+string loopHeader(const Stmt& loop) {
+    return string("for (int ") + kLoopVar + " = 0; " + kLoopVar + " < " + to_string(loop.count) + "; ++" + kLoopVar + ")";
+}
+
+// ---------- Outlining ----------
+// dekhao statements that are the same up to which variables they print
+// share one helper function taking those variables as parameters, so each
+// occurrence costs a call instead of a full inline print sequence. Only
+// shapes used at least minUses times are outlined; below that the calls
+// cost more than the code they save. Off unless --outline is given.
+struct PrintShape {
+    string key;                 // argument tokens with variables replaced by $<n>:<type>
+    vector<Expr> actuals;       // what each $<n> stands for at this site
+    vector<string> types;
+    vector<Expr> body;          // arguments written over p0, p1, ...
+};
+
+class Outliner {
+public:
+    explicit Outliner(int minUses) : minUses(minUses) {}
+
+    Program run(const Program& in) {
+        Program out = in;
+        vector<PrintShape> shapes(in.stmts.size());
+        map<string, int> uses;
+        for (size_t i = 0; i < in.stmts.size(); ++i) {
+            const Stmt& s = in.stmts[i];
+            if (s.kind == Stmt::Decl) vars[s.id] = s.type;
+            else if (s.kind == Stmt::ArrayDecl) { vars[s.id] = s.type; arrays.insert(s.id); }
+            else if (s.kind == Stmt::Print) { shapes[i] = shapeOf(s); uses[shapes[i].key]++; }
+        }
+
+        map<string, string> helperFor;
+        for (size_t i = 0; i < in.stmts.size(); ++i) {
+            const PrintShape& sh = shapes[i];
+            if (in.stmts[i].kind != Stmt::Print || uses[sh.key] < minUses) continue;
+            auto it = helperFor.find(sh.key);
+            if (it == helperFor.end()) {
+                Helper h;
+                h.name = "dekhao_" + to_string(out.helpers.size());
+                for (size_t p = 0; p < sh.types.size(); ++p) h.params.push_back({sh.types[p], "p" + to_string(p)});
+                h.args = sh.body;
+                out.helpers.push_back(h);
+                it = helperFor.insert({sh.key, h.name}).first;
+            }
+            Stmt call;
+            call.kind = Stmt::Call;
+            call.id = it->second;
+            call.args = sh.actuals;
+            out.stmts[i] = call;
+        }
+        return out;
+    }
+
+private:
+    int minUses;
+    map<string, string> vars;   // declared so far -> type keyword
+    set<string> arrays;
+
+    PrintShape shapeOf(const Stmt& s) const {
+        PrintShape sh;
+        map<string, int> param;     // actual text -> parameter number
+        for (auto& a : s.args) {
+            Expr body;
+            for (size_t k = 0; k < a.toks.size(); ++k) {
+                const string& t = a.toks[k];
+                auto v = vars.find(t);
+                if (v == vars.end()) { body.toks.push_back(t); sh.key += t + " "; continue; }
+                Expr actual;
+                actual.toks.push_back(t);
+                // rr<n>_v[3] is one parameter
+                if (arrays.count(t) && k + 3 < a.toks.size() && a.toks[k+1] == "[" && a.toks[k+3] == "]") {
+                    actual.toks.insert(actual.toks.end(), a.toks.begin() + k + 1, a.toks.begin() + k + 4);
+                    k += 3;
+                }
+                actual.text = joinTokens(actual.toks);
+                auto p = param.find(actual.text);
+                if (p == param.end()) {
+                    p = param.insert({actual.text, (int)sh.actuals.size()}).first;
+                    sh.actuals.push_back(actual);
+                    sh.types.push_back(v->second);
+                }
+                body.toks.push_back("p" + to_string(p->second));
+                sh.key += "$" + to_string(p->second) + ":" + v->second + " ";
+            }
+            body.text = joinTokens(body.toks);
+            sh.body.push_back(body);
+            sh.key += ", ";
+        }
+        return sh;
+    }
+};
+
+Program outline(const Program& prog, int minUses = 4) { return Outliner(minUses).run(prog); }
+
+// Keeps helpers out of line, otherwise the compiler would paste them back
+static const char* kOutlinedMacro =
+    "#if defined(__GNUC__)\n"
+    "#define OUTLINED static __attribute__((noinline))\n"
+    "#else\n"
+    "#define OUTLINED static\n"
+    "#endif\n";
+
+string actualList(const Stmt& call) {
+    string out;
+    for (size_t k = 0; k < call.args.size(); ++k) out += (k ? ", " : "") + call.args[k].text;
+    return out;
+}
+
+// ---------- Expression trees ----------
+// Backends that do more than paste the text back need real structure.
+// Nodes live in one vector and refer to their children by index.
+struct ExprNode {
+    enum Kind { Num, Var, Str, Neg, Bin } kind;
+    string text;          // Num/Str: literal spelling, Var: name
+    char op = 0;          // Bin: + - * /
+    int lhs = -1, rhs = -1;
+};
+
+struct ExprTree {
+    vector<ExprNode> nodes;
+    int root = -1;
+    bool ok = true;       // false if the tokens were not a well-formed expression
+};
+
+class ExprParser {
+public:
+    explicit ExprParser(const vector<string>& t) : toks(t) {}
+
+    ExprTree parse() {
+        tree.root = parseSum();
+        if (pos != toks.size()) tree.ok = false;
+        return tree;
+    }
+
+private:
+    const vector<string>& toks;
+    size_t pos = 0;
+    ExprTree tree;
+
+    const string& peek() const { static const string none; return pos < toks.size() ? toks[pos] : none; }
+
+    int add(ExprNode n) { tree.nodes.push_back(n); return (int)tree.nodes.size() - 1; }
+
+    // sum := product (('+' | '-') product)*
+    int parseSum() {
+        int left = parseProduct();
+        while (peek() == "+" || peek() == "-") {
+            char op = toks[pos++][0];
+            int right = parseProduct();
+            left = add({ExprNode::Bin, "", op, left, right});
+        }
+        return left;
+    }
+
+    // product := unary (('*' | '/') unary)*
+    int parseProduct() {
+        int left = parseUnary();
+        while (peek() == "*" || peek() == "/") {
+            char op = toks[pos++][0];
+            int right = parseUnary();
+            left = add({ExprNode::Bin, "", op, left, right});
+        }
+        return left;
+    }
+
+    // unary := '-' unary | primary
+    int parseUnary() {
+        if (peek() == "-") {
+            ++pos;
+            int operand = parseUnary();
+            return add({ExprNode::Neg, "", '-', operand, -1});
+        }
+        return parsePrimary();
+    }
+
+    // primary := number | identifier | "string" | '(' sum ')'
+    int parsePrimary() {
+        const string& t = peek();
+        if (t.empty()) { tree.ok = false; return add({ExprNode::Num, "0"}); }
+        if (t == "(") {
+            ++pos;
+            int inner = parseSum();
+            if (peek() == ")") ++pos; else tree.ok = false;
+            return inner;
+        }
+        ++pos;
+        if (isStringLiteral(t)) return add({ExprNode::Str, t});
+        if (isdigit(static_cast<unsigned char>(t[0]))) {
+            string lit;
+            pos += readNumLiteral(toks, pos - 1, lit) - 1;
+            return add({ExprNode::Num, lit});
+        }
+        if (isalpha(static_cast<unsigned char>(t[0])) || t[0] == '_') return add({ExprNode::Var, t});
+        tree.ok = false;
+        return add({ExprNode::Num, "0"});
+    }
+};
+
+ExprTree parseExprTree(const Expr& e) { return ExprParser(e.toks).parse(); }
+
+// The bytes a "..." literal stands for, escapes decoded as in C++. Cut at
+// the first NUL, as every use of the literal sees it through a const char*.
+// False for escapes C++ would reject.
+bool decodeStringLiteral(const string& t, string& out) {
+    out.clear();
+    if (!isStringLiteral(t)) return false;
+    const size_t end = t.size() - 1;
+    for (size_t k = 1; k < end; ++k) {
+        char c = t[k];
+        if (c != '\\') { out += c; continue; }
+        if (++k >= end) return false;
+        c = t[k];
+        switch (c) {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case 'a': out += '\a'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'v': out += '\v'; break;
+        case '\\': case '\'': case '"': case '?': out += c; break;
+        case 'x': {
+            int v = 0; size_t from = k + 1;
+            while (k + 1 < end && isxdigit(static_cast<unsigned char>(t[k+1]))) {
+                char h = static_cast<char>(tolower(static_cast<unsigned char>(t[++k])));
+                v = v * 16 + (isdigit(static_cast<unsigned char>(h)) ? h - '0' : h - 'a' + 10);
+                if (v > 255) return false;
+            }
+            if (k + 1 == from) return false;
+            out += static_cast<char>(v);
+            break;
+        }
+        default: {
+            if (c < '0' || c > '7') return false;
+            int v = c - '0';
+            for (int n = 1; n < 3 && k + 1 < end && t[k+1] >= '0' && t[k+1] <= '7'; ++n) v = v * 8 + (t[++k] - '0');
+            if (v > 255) return false;
+            out += static_cast<char>(v);
+        }
+        }
+    }
+    size_t nul = out.find('\0');
+    if (nul != string::npos) out.resize(nul);
+    return true;
+}
+
+// ---------- C++ backend ----------
+string emitCpp(const Program& prog) {
+    ostringstream out;
 
     // Headers
     out << "#include <iostream>\n";
-    if (usesString) out << "#include <string>\n";
+    if (prog.usesString) out << "#include <string>\n";
     out << "using namespace std;\n\n";
+    if (!prog.helpers.empty()) out << kOutlinedMacro << "\n";
+    for (auto& h : prog.helpers) {
+        out << "OUTLINED void " << h.name << "(";
+        for (size_t k = 0; k < h.params.size(); ++k) {
+            const string& t = h.params[k].first;
+            out << (k ? ", " : "") << (t == "string" ? "const std::string&" : cppType(t)) << " " << h.params[k].second;
+        }
+        out << ") {\n    std::cout";
+        for (auto& a : h.args) out << " << " << a.text;
+        out << " << std::endl;\n}\n\n";
+    }
     out << "int main() {\n";
-    for (auto& s : body) out << "    " << s << "\n";
+    for (auto& s : prog.stmts) {
+        if (s.kind == Stmt::ArrayDecl) { out << arrayDeclCode(s, cppType(s.type)); continue; }
+        out << "    ";
+        if (s.kind == Stmt::Decl) {
+            out << cppType(s.type) << " " << s.id << " = " << s.value.text << ";";
+        } else if (s.kind == Stmt::Call) {
+            out << s.id << "(" << actualList(s) << ");";
+        } else {
+            if (s.kind == Stmt::Loop) out << loopHeader(s) << " ";
+            out << "std::cout";
+            for (auto &a : s.args) out << " << " << a.text;
+            out << " << std::endl;";
+        }
+        out << "\n";
+    }
+    out << "    return 0;\n}\n";
+    return out.str();
+}
+
+// ---------- C backend ----------
+// Plain C99 with a tiny buffered print runtime. <stdio.h> is a fraction of
+// the size of <iostream>, so the generated file compiles several times faster.
+static const char* kCRuntime =
+    "#if defined(__GNUC__)\n"
+    "#define RT_FN static __attribute__((unused))\n"
+    "#else\n"
+    "#define RT_FN static\n"
+    "#endif\n"
+    "static char rt_buf[1 << 16];\n"
+    "static size_t rt_len;\n"
+    "RT_FN void rt_flush(void) { fwrite(rt_buf, 1, rt_len, stdout); rt_len = 0; }\n"
+    "RT_FN void rt_put(const char* s, size_t n) {\n"
+    "    if (rt_len + n > sizeof rt_buf) rt_flush();\n"
+    "    if (n > sizeof rt_buf) { fwrite(s, 1, n, stdout); return; }\n"
+    "    memcpy(rt_buf + rt_len, s, n); rt_len += n;\n"
+    "}\n"
+    "RT_FN void rt_str(const char* s) { rt_put(s, strlen(s)); }\n"
+    "RT_FN void rt_int(long long v) { char b[24]; rt_put(b, (size_t)snprintf(b, sizeof b, \"%lld\", v)); }\n"
+    "RT_FN void rt_flt(double v) { char b[32]; rt_put(b, (size_t)snprintf(b, sizeof b, \"%g\", v)); }\n"
+    "RT_FN void rt_nl(void) { rt_put(\"\\n\", 1); }\n";
+
+// Only pulled in when the script declares a string
+static const char* kCStringRuntime =
+    "RT_FN const char* rt_cat(const char* a, const char* b) {\n"
+    "    size_t n = strlen(a), m = strlen(b);\n"
+    "    char* r = (char*)malloc(n + m + 1);\n"
+    "    memcpy(r, a, n); memcpy(r + n, b, m + 1);\n"
+    "    return r;\n"
+    "}\n";
+
+// String expressions only support '+' (concatenation); everything else is
+// valid C as written.
+string cExpr(const Expr& e, const string& type) {
+    if (type != "string") return e.text;
+    string acc, cur;
+    int depth = 0;
+    auto flush = [&](){
+        if (acc.empty()) acc = cur;
+        else acc = "rt_cat(" + acc + ", " + cur + ")";
+        cur.clear();
+    };
+    for (auto& t : e.toks) {
+        if (t == "(") depth++;
+        if (t == ")") depth--;
+        if (t == "+" && depth == 0) { flush(); continue; }
+        if (!cur.empty() && !t.empty() && (isalnum(static_cast<unsigned char>(t[0])) || t[0]=='_')
+            && (isalnum(static_cast<unsigned char>(cur.back())) || cur.back()=='_')) cur += ' ';
+        cur += t;
+    }
+    flush();
+    return acc;
+}
+
+void emitCPrint(ostringstream& out, const vector<Expr>& args, const map<string, string>& vars, const string& pad) {
+    for (auto& a : args) {
+        string t = exprType(a, vars);
+        if (t == "string")     out << pad << "rt_str(" << cExpr(a, t) << ");\n";
+        else if (t == "float") out << pad << "rt_flt((double)(" << a.text << "));\n";
+        else                   out << pad << "rt_int((long long)(" << a.text << "));\n";
+    }
+    out << pad << "rt_nl();\n";
+}
+
+string emitC(const Program& prog) {
+    ostringstream out;
+    map<string, string> vars;
+
+    out << "#include <stdio.h>\n";
+    out << "#include <string.h>\n";
+    if (prog.usesString) out << "#include <stdlib.h>\n";
+    out << "\n" << kCRuntime;
+    if (prog.usesString) out << kCStringRuntime;
+    if (!prog.helpers.empty()) out << "\n" << kOutlinedMacro;
+    for (auto& h : prog.helpers) {
+        map<string, string> params;
+        out << "\nOUTLINED void " << h.name << "(";
+        for (size_t k = 0; k < h.params.size(); ++k) {
+            out << (k ? ", " : "") << cType(h.params[k].first) << " " << h.params[k].second;
+            params[h.params[k].second] = h.params[k].first;
+        }
+        if (h.params.empty()) out << "void";
+        out << ") {\n";
+        emitCPrint(out, h.args, params, "    ");
+        out << "}\n";
+    }
+    out << "\nint main(void) {\n";
+    for (auto& s : prog.stmts) {
+        if (s.kind == Stmt::Decl) {
+            out << "    " << cType(s.type) << " " << s.id << " = " << cExpr(s.value, s.type) << ";\n";
+            vars[s.id] = s.type;
+        } else if (s.kind == Stmt::ArrayDecl) {
+            out << arrayDeclCode(s, cType(s.type));
+            vars[s.id] = s.type;
+        } else if (s.kind == Stmt::Call) {
+            out << "    " << s.id << "(" << actualList(s) << ");\n";
+        } else {
+            string pad = "    ";
+            if (s.kind == Stmt::Loop) { out << pad << loopHeader(s) << " {\n"; pad += "    "; }
+            emitCPrint(out, s.args, vars, pad);
+            if (s.kind == Stmt::Loop) out << "    }\n";
+        }
+    }
+    out << "    rt_flush();\n";
     out << "    return 0;\n}\n";
     return out.str();
 }
 
-int main() {
+// ---------- Table-driven backend ----------
+// For scripts made only of integer declarations and dekhao of integer
+// expressions / string literals. The program becomes data (constants,
+// strings, bytecode) run by a fixed interpreter loop, so the C compiler
+// sees the same small function whatever the script length.
+enum TableOp { OP_PUSH, OP_LOAD, OP_STORE, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_NEG, OP_PRINTI, OP_PRINTS, OP_NL, OP_HALT };
+
+struct TableProgram {
+    vector<string> consts;     // integer literals, in decimal
+    vector<string> strings;    // string literals, quotes included
+    vector<unsigned> code;     // (operand << 4) | opcode
+    int numVars = 0;
+    int maxDepth = 0;
+};
+
+class TableCompiler {
+public:
+    bool compile(const Program& prog) {
+        for (auto& s : prog.stmts) {
+            if (s.kind == Stmt::Decl) {
+                if (s.type != "integer" || slots.count(s.id)) return false;
+                ExprTree t = parseExprTree(s.value);
+                if (!t.ok || !compileInt(t, t.root)) return false;
+                int slot = (int)slots.size();
+                slots[s.id] = slot;
+                emit(OP_STORE, slot, -1);
+            } else {
+                for (auto& a : s.args) {
+                    ExprTree t = parseExprTree(a);
+                    if (!t.ok) return false;
+                    if (t.nodes[t.root].kind == ExprNode::Str) {
+                        emit(OP_PRINTS, intern(strIndex, out.strings, t.nodes[t.root].text), 0);
+                    } else {
+                        if (!compileInt(t, t.root)) return false;
+                        emit(OP_PRINTI, 0, -1);
+                    }
+                }
+                emit(OP_NL, 0, 0);
+            }
+        }
+        emit(OP_HALT, 0, 0);
+        out.numVars = (int)slots.size();
+        return true;
+    }
+
+    const TableProgram& result() const { return out; }
+
+private:
+    TableProgram out;
+    map<string, int> slots, constIndex, strIndex;
+    int depth = 0;
+
+    static int intern(map<string, int>& index, vector<string>& pool, const string& v) {
+        auto it = index.find(v);
+        if (it != index.end()) return it->second;
+        index[v] = (int)pool.size();
+        pool.push_back(v);
+        return (int)pool.size() - 1;
+    }
+
+    // stackDelta: net effect of the op on the evaluation stack
+    void emit(TableOp op, int operand, int stackDelta) {
+        out.code.push_back((static_cast<unsigned>(operand) << 4) | op);
+        depth += stackDelta;
+        out.maxDepth = max(out.maxDepth, depth);
+    }
+
+    // Post-order: operands first, then the operator
+    bool compileInt(const ExprTree& t, int n) {
+        const ExprNode& e = t.nodes[n];
+        switch (e.kind) {
+        case ExprNode::Num: {
+            NumLiteral lit;
+            if (!parseNumLiteral(e.text, lit) || lit.isFloat) return false;
+            emit(OP_PUSH, intern(constIndex, out.consts, to_string(lit.i)), +1);
+            return true;
+        }
+        case ExprNode::Var: {
+            auto it = slots.find(e.text);
+            if (it == slots.end()) return false;
+            emit(OP_LOAD, it->second, +1);
+            return true;
+        }
+        case ExprNode::Neg:
+            if (!compileInt(t, e.lhs)) return false;
+            emit(OP_NEG, 0, 0);
+            return true;
+        case ExprNode::Bin:
+            if (!compileInt(t, e.lhs) || !compileInt(t, e.rhs)) return false;
+            emit(e.op == '+' ? OP_ADD : e.op == '-' ? OP_SUB : e.op == '*' ? OP_MUL : OP_DIV, 0, -1);
+            return true;
+        default:
+            return false;
+        }
+    }
+};
+
+// Comma-separated initializer, a fixed number of items per line
+template <class T>
+void emitTableData(ostringstream& out, const vector<T>& items) {
+    for (size_t k = 0; k < items.size(); ++k) {
+        if (k % 16 == 0) out << "\n    ";
+        out << items[k] << ",";
+    }
+    if (items.empty()) out << "0";
+    out << "\n";
+}
+
+bool emitTable(const Program& prog, string& code) {
+    TableCompiler tc;
+    if (!tc.compile(prog)) return false;
+    const TableProgram& tp = tc.result();
+
+    ostringstream out;
+    out << "#include <stdio.h>\n\n";
+    out << "enum { OP_PUSH, OP_LOAD, OP_STORE, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_NEG, OP_PRINTI, OP_PRINTS, OP_NL, OP_HALT };\n\n";
+    out << "static const int K[] = {";
+    emitTableData(out, tp.consts);
+    out << "};\n";
+    out << "static const char* const S[] = {";
+    emitTableData(out, tp.strings);
+    out << "};\n";
+    out << "static const unsigned code[] = {";
+    emitTableData(out, tp.code);
+    out << "};\n\n";
+    out << "int main(void) {\n";
+    out << "    static int v[" << max(tp.numVars, 1) << "];\n";
+    out << "    int st[" << max(tp.maxDepth, 1) << "], sp = 0;\n";
+    out << "    const unsigned* pc;\n";
+    out << "    for (pc = code;; ++pc) {\n";
+    out << "        unsigned a = *pc >> 4;\n";
+    out << "        switch (*pc & 15u) {\n";
+    out << "        case OP_PUSH:   st[sp++] = K[a]; break;\n";
+    out << "        case OP_LOAD:   st[sp++] = v[a]; break;\n";
+    out << "        case OP_STORE:  v[a] = st[--sp]; break;\n";
+    out << "        case OP_ADD:    --sp; st[sp-1] += st[sp]; break;\n";
+    out << "        case OP_SUB:    --sp; st[sp-1] -= st[sp]; break;\n";
+    out << "        case OP_MUL:    --sp; st[sp-1] *= st[sp]; break;\n";
+    out << "        case OP_DIV:    --sp; st[sp-1] /= st[sp]; break;\n";
+    out << "        case OP_NEG:    st[sp-1] = -st[sp-1]; break;\n";
+    out << "        case OP_PRINTI: printf(\"%d\", st[--sp]); break;\n";
+    out << "        case OP_PRINTS: fputs(S[a], stdout); break;\n";
+    out << "        case OP_NL:     putchar('\\n'); break;\n";
+    out << "        default:        return 0;\n";
+    out << "        }\n";
+    out << "    }\n";
+    out << "}\n";
+    code = out.str();
+    return true;
+}
+
+// ---------- Partial evaluation ----------
+// Everything in these scripts is known at transpile time unless an
+// expression cannot be reproduced exactly here (division by zero, int
+// overflow, unknown names, escapes in literals, ...). Those stay "dynamic".
+struct Value {
+    enum Kind { Dynamic, Int, Float, Double, Str } kind = Dynamic;
+    long long i = 0;      // Int
+    double d = 0;         // Float (stored rounded to float) / Double
+    string s;             // Str
+    bool isLiteral = false; // Str: a "..." literal (const char*), not a std::string
+};
+
+Value dynamicValue() { return Value(); }
+
+Value intValue(long long v) {
+    Value r;
+    if (v < INT_MIN || v > INT_MAX) return r;   // would overflow int
+    r.kind = Value::Int; r.i = v;
+    return r;
+}
+
+Value floatValue(double v, Value::Kind k) {
+    Value r; r.kind = k;
+    r.d = (k == Value::Float) ? static_cast<double>(static_cast<float>(v)) : v;
+    return r;
+}
+
+double asDouble(const Value& v) { return v.kind == Value::Int ? static_cast<double>(v.i) : v.d; }
+
+// Usual arithmetic conversions for the types the language has
+Value arith(char op, const Value& a, const Value& b) {
+    if (a.kind == Value::Dynamic || b.kind == Value::Dynamic) return dynamicValue();
+    if (a.kind == Value::Str || b.kind == Value::Str) {
+        // std::string + std::string / + literal concatenates; two literals do not compile
+        if (op != '+' || a.kind != Value::Str || b.kind != Value::Str || (a.isLiteral && b.isLiteral)) return dynamicValue();
+        Value r; r.kind = Value::Str; r.s = a.s + b.s;
+        return r;
+    }
+    if (a.kind == Value::Int && b.kind == Value::Int) {
+        switch (op) {
+        case '+': return intValue(a.i + b.i);
+        case '-': return intValue(a.i - b.i);
+        case '*': return intValue(a.i * b.i);
+        default:
+            if (b.i == 0 || (a.i == INT_MIN && b.i == -1)) return dynamicValue();
+            return intValue(a.i / b.i);
+        }
+    }
+    Value::Kind k = (a.kind == Value::Double || b.kind == Value::Double) ? Value::Double : Value::Float;
+    double x = asDouble(a), y = asDouble(b);
+    if (k == Value::Float) { x = static_cast<float>(x); y = static_cast<float>(y); }
+    switch (op) {
+    case '+': return floatValue(x + y, k);
+    case '-': return floatValue(x - y, k);
+    case '*': return floatValue(x * y, k);
+    default:  return floatValue(x / y, k);
+    }
+}
+
+Value evalExpr(const ExprTree& t, int n, const map<string, Value>& env) {
+    const ExprNode& e = t.nodes[n];
+    switch (e.kind) {
+    case ExprNode::Num: {
+        NumLiteral lit;
+        if (!parseNumLiteral(e.text, lit)) return dynamicValue();
+        return lit.isFloat ? floatValue(lit.d, Value::Double) : intValue(lit.i);
+    }
+    case ExprNode::Str: {
+        if (e.text.find('\\') != string::npos) return dynamicValue();
+        Value r; r.kind = Value::Str; r.isLiteral = true;
+        r.s = e.text.substr(1, e.text.size() - 2);
+        return r;
+    }
+    case ExprNode::Var: {
+        auto it = env.find(e.text);
+        return it == env.end() ? dynamicValue() : it->second;
+    }
+    case ExprNode::Neg: {
+        Value v = evalExpr(t, e.lhs, env);
+        if (v.kind == Value::Int) return intValue(-v.i);
+        if (v.kind == Value::Float || v.kind == Value::Double) return floatValue(-v.d, v.kind);
+        return dynamicValue();
+    }
+    case ExprNode::Bin:
+        return arith(e.op, evalExpr(t, e.lhs, env), evalExpr(t, e.rhs, env));
+    }
+    return dynamicValue();
+}
+
+// What `std::cout << v` would print (default precision 6 == %g)
+string formatValue(const Value& v) {
+    if (v.kind == Value::Int) return to_string(v.i);
+    if (v.kind == Value::Str) return v.s;
+    char buf[64];
+    snprintf(buf, sizeof buf, "%g", v.d);
+    return buf;
+}
+
+// Converts an initializer to the declared type, as the C++ declaration would
+Value convertTo(const string& type, const Value& v) {
+    if (v.kind == Value::Dynamic) return v;
+    if (type == "string") {
+        if (v.kind != Value::Str) return dynamicValue();
+        Value r = v; r.isLiteral = false;
+        return r;
+    }
+    if (v.kind == Value::Str) return dynamicValue();
+    if (type == "integer") {
+        if (v.kind == Value::Int) return v;
+        if (!(v.d > INT_MIN - 1.0 && v.d < INT_MAX + 1.0)) return dynamicValue();
+        return intValue(static_cast<long long>(v.d));
+    }
+    return floatValue(asDouble(v), Value::Float);
+}
+
+// Bytes as a C string literal, wrapped every 64 bytes
+string cStringLiteral(const string& bytes) {
+    ostringstream out;
+    out << "\"";
+    for (size_t k = 0; k < bytes.size(); ++k) {
+        unsigned char c = bytes[k];
+        if (c == '\\' || c == '"') out << '\\' << c;
+        else if (c == '\n') out << "\\n";
+        else if (c >= 32 && c < 127 && c != '?') out << c;
+        else out << '\\' << oct << setw(3) << setfill('0') << static_cast<int>(c) << dec;
+        if (k % 64 == 63 && k + 1 < bytes.size()) out << "\"\n    \"";
+    }
+    out << "\"";
+    return out.str();
+}
+
+// Fully constant scripts become one precomputed buffer and a write() loop.
+// Otherwise a residual C++ program: constant dekhao arguments are replaced by
+// their text, consecutive constant output is merged into one cout.write().
+// Returns false when the script is not fully constant and C output was asked for.
+bool emitFolded(const Program& prog, bool cOnly, string& code) {
+    map<string, Value> env;
+    vector<pair<bool, string>> pieces;   // (constant text?, text or C++ statement)
+    bool allConst = true;
+
+    auto addText = [&](const string& text){
+        if (!pieces.empty() && pieces.back().first) pieces.back().second += text;
+        else pieces.push_back({true, text});
+    };
+
+    for (auto& s : prog.stmts) {
+        if (s.kind == Stmt::Decl) {
+            ExprTree t = parseExprTree(s.value);
+            Value v = t.ok ? convertTo(s.type, evalExpr(t, t.root, env)) : dynamicValue();
+            env[s.id] = v;
+            if (v.kind == Value::Dynamic) allConst = false;
+            pieces.push_back({false, cppType(s.type) + " " + s.id + " = " + s.value.text + ";"});
+            continue;
+        }
+        for (auto& a : s.args) {
+            ExprTree t = parseExprTree(a);
+            Value v = t.ok ? evalExpr(t, t.root, env) : dynamicValue();
+            if (v.kind == Value::Dynamic) {
+                allConst = false;
+                pieces.push_back({false, "std::cout << " + a.text + ";"});
+            } else {
+                addText(formatValue(v));
+            }
+        }
+        addText("\n");
+    }
+
+    ostringstream out;
+    if (allConst) {
+        string blob;
+        for (auto& p : pieces) if (p.first) blob += p.second;
+        out << "#ifdef _WIN32\n#include <io.h>\n#define write _write\n#else\n#include <unistd.h>\n#endif\n\n";
+        out << "static const char out[] =\n    " << cStringLiteral(blob) << ";\n\n";
+        out << "int main(void) {\n";
+        out << "    const char* p = out;\n";
+        out << "    unsigned long n = sizeof out - 1;\n";
+        out << "    while (n > 0) {\n";
+        out << "        long w = (long)write(1, p, n);\n";
+        out << "        if (w <= 0) return 1;\n";
+        out << "        p += w; n -= (unsigned long)w;\n";
+        out << "    }\n";
+        out << "    return 0;\n}\n";
+        code = out.str();
+        return true;
+    }
+    if (cOnly) return false;
+
+    out << "#include <iostream>\n";
+    if (prog.usesString) out << "#include <string>\n";
+    out << "using namespace std;\n\n";
+    out << "int main() {\n";
+    for (auto& p : pieces) {
+        if (p.first) out << "    std::cout.write(" << cStringLiteral(p.second) << ", " << p.second.size() << ");\n";
+        else         out << "    " << p.second << "\n";
+    }
+    out << "    std::cout.flush();\n";
+    out << "    return 0;\n}\n";
+    code = out.str();
+    return true;
+}
+
+// ---------- In-process backend (libgccjit) ----------
+// Builds the program straight from the parsed statements with libgccjit:
+// no generated file, no compiler process, no <iostream> to parse. Either
+// runs it right away or writes an object file. Optional, since libgccjit
+// is not installed everywhere:
+//     g++ -DHAVE_LIBGCCJIT main.cpp -lgccjit
+#ifdef HAVE_LIBGCCJIT
+#include <libgccjit.h>
+
+class JitCompiler {
+public:
+    JitCompiler() : ctxt(gcc_jit_context_acquire()) {
+        gcc_jit_context_set_int_option(ctxt, GCC_JIT_INT_OPTION_OPTIMIZATION_LEVEL, 2);
+        intType    = gcc_jit_context_get_type(ctxt, GCC_JIT_TYPE_INT);
+        floatType  = gcc_jit_context_get_type(ctxt, GCC_JIT_TYPE_FLOAT);
+        doubleType = gcc_jit_context_get_type(ctxt, GCC_JIT_TYPE_DOUBLE);
+        strType    = gcc_jit_context_get_type(ctxt, GCC_JIT_TYPE_CONST_CHAR_PTR);
+
+        gcc_jit_param* fmt = gcc_jit_context_new_param(ctxt, nullptr, strType, "fmt");
+        printfFn = gcc_jit_context_new_function(ctxt, nullptr, GCC_JIT_FUNCTION_IMPORTED,
+                                                intType, "printf", 1, &fmt, 1);
+        mainFn = gcc_jit_context_new_function(ctxt, nullptr, GCC_JIT_FUNCTION_EXPORTED,
+                                              intType, "main", 0, nullptr, 0);
+        block = gcc_jit_function_new_block(mainFn, "entry");
+    }
+    ~JitCompiler() { gcc_jit_context_release(ctxt); }
+
+    // Lowers the whole program into main(); false (with `error` set) on
+    // constructs this backend does not support
+    bool lower(const Program& prog, string& error) {
+        for (auto& s : prog.stmts) {
+            if (s.kind == Stmt::Decl) {
+                ExprTree t = parseExprTree(s.value);
+                Operand v;
+                if (!t.ok || !lowerExpr(t, t.root, v, error)) return fail(error, s.id);
+                char kind = s.type == "integer" ? 'i' : s.type == "float" ? 'f' : 's';
+                if ((kind == 's') != (v.kind == 's')) { error = "type mismatch in declaration of " + s.id; return false; }
+                gcc_jit_lvalue* local = gcc_jit_function_new_local(mainFn, nullptr, typeOf(kind), s.id.c_str());
+                gcc_jit_block_add_assignment(block, nullptr, local, convert(v, kind).rv);
+                vars[s.id] = {gcc_jit_lvalue_as_rvalue(local), kind};
+            } else if (s.kind == Stmt::Print) {
+                for (auto& a : s.args) {
+                    ExprTree t = parseExprTree(a);
+                    Operand v;
+                    if (!t.ok || !lowerExpr(t, t.root, v, error)) return fail(error, a.text);
+                    // varargs: float is passed as double
+                    if (v.kind == 'i')      callPrintf("%d", v.rv);
+                    else if (v.kind == 's') callPrintf("%s", v.rv);
+                    else                    callPrintf("%g", convert(v, 'd').rv);
+                }
+                callPrintf("\n", nullptr);
+            }
+        }
+        gcc_jit_block_end_with_return(block, nullptr, gcc_jit_context_new_rvalue_from_int(ctxt, intType, 0));
+        return true;
+    }
+
+    // Compiles in memory and calls main()
+    bool run(string& error) {
+        gcc_jit_result* result = gcc_jit_context_compile(ctxt);
+        if (!result) { error = firstError(); return false; }
+        typedef int (*MainFn)();
+        MainFn fn = reinterpret_cast<MainFn>(gcc_jit_result_get_code(result, "main"));
+        cout.flush();
+        fn();
+        fflush(stdout);
+        gcc_jit_result_release(result);
+        return true;
+    }
+
+    bool writeObject(const string& path, string& error) {
+        gcc_jit_context_compile_to_file(ctxt, GCC_JIT_OUTPUT_KIND_OBJECT_FILE, path.c_str());
+        const char* e = gcc_jit_context_get_first_error(ctxt);
+        if (e) { error = e; return false; }
+        return true;
+    }
+
+private:
+    // kind: 'i' int, 'f' float, 'd' double, 's' const char*
+    struct Operand { gcc_jit_rvalue* rv = nullptr; char kind = 'i'; };
+
+    gcc_jit_context* ctxt;
+    gcc_jit_type *intType, *floatType, *doubleType, *strType;
+    gcc_jit_function *printfFn, *mainFn;
+    gcc_jit_block* block;
+    map<string, Operand> vars;
+
+    static bool fail(string& error, const string& where) {
+        if (error.empty()) error = "malformed expression";
+        error += " (in " + where + ")";
+        return false;
+    }
+
+    string firstError() const {
+        const char* e = gcc_jit_context_get_first_error(ctxt);
+        return e ? e : "libgccjit compilation failed";
+    }
+
+    gcc_jit_type* typeOf(char kind) const {
+        switch (kind) {
+        case 'f': return floatType;
+        case 'd': return doubleType;
+        case 's': return strType;
+        default:  return intType;
+        }
+    }
+
+    Operand convert(const Operand& v, char kind) {
+        if (v.kind == kind) return v;
+        return {gcc_jit_context_new_cast(ctxt, nullptr, v.rv, typeOf(kind)), kind};
+    }
+
+    void callPrintf(const char* fmt, gcc_jit_rvalue* arg) {
+        gcc_jit_rvalue* args[2] = {gcc_jit_context_new_string_literal(ctxt, fmt), arg};
+        gcc_jit_block_add_eval(block, nullptr, gcc_jit_context_new_call(ctxt, nullptr, printfFn, arg ? 2 : 1, args));
+    }
+
+    bool lowerExpr(const ExprTree& t, int n, Operand& out, string& error) {
+        const ExprNode& e = t.nodes[n];
+        switch (e.kind) {
+        case ExprNode::Num: {
+            NumLiteral lit;
+            if (!parseNumLiteral(e.text, lit)) { error = "unsupported number literal " + e.text; return false; }
+            if (lit.isFloat) out = {gcc_jit_context_new_rvalue_from_double(ctxt, doubleType, lit.d), 'd'};
+            else             out = {gcc_jit_context_new_rvalue_from_int(ctxt, intType, static_cast<int>(lit.i)), 'i'};
+            return true;
+        }
+        case ExprNode::Str: {
+            string bytes;
+            if (!decodeStringLiteral(e.text, bytes)) { error = "unsupported string literal " + e.text; return false; }
+            out = {gcc_jit_context_new_string_literal(ctxt, bytes.c_str()), 's'};
+            return true;
+        }
+        case ExprNode::Var: {
+            auto it = vars.find(e.text);
+            if (it == vars.end()) { error = "unknown variable " + e.text; return false; }
+            out = it->second;
+            return true;
+        }
+        case ExprNode::Neg: {
+            Operand v;
+            if (!lowerExpr(t, e.lhs, v, error)) return false;
+            if (v.kind == 's') { error = "cannot negate a string"; return false; }
+            out = {gcc_jit_context_new_unary_op(ctxt, nullptr, GCC_JIT_UNARY_OP_MINUS, typeOf(v.kind), v.rv), v.kind};
+            return true;
+        }
+        case ExprNode::Bin: {
+            Operand l, r;
+            if (!lowerExpr(t, e.lhs, l, error) || !lowerExpr(t, e.rhs, r, error)) return false;
+            if (l.kind == 's' || r.kind == 's') { error = "string arithmetic is not supported by the JIT backend"; return false; }
+            char kind = (l.kind == 'd' || r.kind == 'd') ? 'd' : (l.kind == 'f' || r.kind == 'f') ? 'f' : 'i';
+            gcc_jit_binary_op op = e.op == '+' ? GCC_JIT_BINARY_OP_PLUS
+                                 : e.op == '-' ? GCC_JIT_BINARY_OP_MINUS
+                                 : e.op == '*' ? GCC_JIT_BINARY_OP_MULT : GCC_JIT_BINARY_OP_DIVIDE;
+            out = {gcc_jit_context_new_binary_op(ctxt, nullptr, op, typeOf(kind), convert(l, kind).rv, convert(r, kind).rv), kind};
+            return true;
+        }
+        }
+        return false;
+    }
+};
+#endif
+
+// objectFile empty: run the program now; otherwise write it as an object file
+bool jitProgram(const Program& prog, const string& objectFile) {
+#ifdef HAVE_LIBGCCJIT
+    JitCompiler jc;
+    string error;
+    bool ok = jc.lower(prog, error)
+           && (objectFile.empty() ? jc.run(error) : jc.writeObject(objectFile, error));
+    if (!ok) cerr << "Error: JIT backend: " << error << "\n";
+    return ok;
+#else
+    (void)prog; (void)objectFile;
+    cerr << "Error: this transpiler was built without libgccjit (rebuild with -DHAVE_LIBGCCJIT -lgccjit)\n";
+    return false;
+#endif
+}
+
+// ---------- Build driver ----------
+// Compiles the generated file into ./generated(.exe). Every build is keyed
+// by a hash of the source, the compiler command and version and (for PGO)
+// the training input, so rebuilding an unchanged program is just a copy out
+// of the cache. Binaries are built under a temp name and renamed into place,
+// so an interrupted build never leaves a partial entry behind; the least
+// recently used entries go once the cache outgrows kBuildCacheLimit.
+#ifdef _WIN32
+static const char* kExeSuffix = ".exe";
+static const char* kNullDevice = "NUL";
+#define popen _popen
+#define pclose _pclose
+#else
+static const char* kExeSuffix = "";
+static const char* kNullDevice = "/dev/null";
+#endif
+static const char* kBuildCacheDir = ".build-cache";
+static const char* kBuildCachePrefix = "class2-";   // every binary we cache is named class2-<key>
+static const uintmax_t kBuildCacheLimit = 256ull << 20;
+
+string readWholeFile(const string& path) {
+    ifstream in(path, ios::binary);
+    ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// The build cache key: FNV-1a over every input of a build, with a separator
+// after each part so that moving bytes between parts changes the key
+string hashKey(const vector<string>& parts) {
+    unsigned long long h = 1469598103934665603ULL;
+    for (auto& p : parts) {
+        for (unsigned char c : p) { h ^= c; h *= 1099511628211ULL; }
+        h ^= 0xff; h *= 1099511628211ULL;   // part separator
+    }
+    ostringstream ss;
+    ss << hex << setw(16) << setfill('0') << h;
+    return ss.str();
+}
+
+bool runCommand(const string& cmd) {
+    cout << "$ " << cmd << "\n";
+    return system(cmd.c_str()) == 0;
+}
+
+bool copyOut(const string& from, const string& to) {
+    error_code ec;
+    filesystem::copy_file(from, to, filesystem::copy_options::overwrite_existing, ec);
+    if (ec) cerr << "Error: could not copy " << from << " to " << to << ": " << ec.message() << "\n";
+    return !ec;
+}
+
+string compilerFor(bool cSource) {
+    const char* env = getenv(cSource ? "CC" : "CXX");
+    if (env && *env) return env;
+    return cSource ? "gcc" : "g++";
+}
+
+// `cc --version`, so an upgraded compiler does not pick up old binaries
+string compilerVersion(const string& cc) {
+    FILE* p = popen((cc + " --version 2>" + kNullDevice).c_str(), "r");
+    if (!p) return "";
+    string out;
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, p)) > 0) out.append(buf, n);
+    pclose(p);
+    return out;
+}
+
+// Moves a finished build into the cache; false (temp file removed) on failure
+bool publish(const string& tmp, const string& cached) {
+    error_code ec;
+    filesystem::rename(tmp, cached, ec);
+    if (ec) {
+        cerr << "Error: could not store " << cached << ": " << ec.message() << "\n";
+        filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+// Drops the least recently used binaries until the cache fits in `limit`.
+// Only our own entries count: class3 keeps its class3-*.bin in the same
+// directory. Temp files of builds still running and PGO work directories
+// are left alone.
+void pruneBuildCache(uintmax_t limit) {
+    error_code ec;
+    vector<pair<filesystem::file_time_type, filesystem::path>> entries;
+    uintmax_t total = 0;
+    for (auto& e : filesystem::directory_iterator(kBuildCacheDir, ec)) {
+        string name = e.path().filename().string();
+        if (!e.is_regular_file(ec) || name.rfind(kBuildCachePrefix, 0) != 0 || name.find(".tmp") != string::npos) continue;
+        total += e.file_size(ec);
+        entries.push_back({e.last_write_time(ec), e.path()});
+    }
+    sort(entries.begin(), entries.end());
+    for (auto& entry : entries) {
+        if (total <= limit) break;
+        uintmax_t size = filesystem::file_size(entry.second, ec);
+        if (filesystem::remove(entry.second, ec)) total -= size;
+    }
+}
+
+// Plain optimized build. trainingInput non-empty: profile-guided build, i.e.
+// instrument, run once on the training input, rebuild with the profile.
+bool buildGenerated(const string& srcFile, bool cSource, const string& trainingInput) {
+    const string cc = compilerFor(cSource);
+    const string flags = "-O2";
+    const string exe = string("generated") + kExeSuffix;
+    const string source = readWholeFile(srcFile);
+
+    vector<string> keyParts = {source, cc, compilerVersion(cc), flags};
+    if (!trainingInput.empty()) {
+        keyParts.push_back("pgo");
+        keyParts.push_back(readWholeFile(trainingInput));
+    }
+    const string key = hashKey(keyParts);
+    const string cached = string(kBuildCacheDir) + "/" + kBuildCachePrefix + key + kExeSuffix;
+
+    error_code ec;
+    filesystem::create_directories(kBuildCacheDir, ec);
+    if (filesystem::exists(cached)) {
+        cout << "Build cache hit (" << key << ")\n";
+        filesystem::last_write_time(cached, filesystem::file_time_type::clock::now(), ec);
+        return copyOut(cached, exe);
+    }
+    const string tmp = string(kBuildCacheDir) + "/" + kBuildCachePrefix + key + ".tmp" + to_string(random_device{}()) + kExeSuffix;
+
+    if (trainingInput.empty()) {
+        if (!runCommand(cc + " " + flags + " -o \"" + tmp + "\" " + srcFile)) { filesystem::remove(tmp, ec); return false; }
+        if (!publish(tmp, cached)) return false;
+        pruneBuildCache(kBuildCacheLimit);
+        return copyOut(cached, exe);
+    }
+
+    // PGO. The object path must be identical in both compiles, since it
+    // names the .gcda file the instrumented binary writes. The directory is
+    // per process, like tmp, so concurrent builds of the same key do not
+    // delete each other's profile.
+    const string work = string(kBuildCacheDir) + "/pgo-" + key + "." + to_string(random_device{}());
+    filesystem::remove_all(work, ec);
+    filesystem::create_directories(work, ec);
+    const string obj = work + "/prog.o";
+    const string instrumented = work + "/instrumented" + kExeSuffix;
+
+    bool ok = runCommand(cc + " " + flags + " -fprofile-generate=\"" + work + "\" -c " + srcFile + " -o \"" + obj + "\"")
+           && runCommand(cc + " -fprofile-generate=\"" + work + "\" \"" + obj + "\" -o \"" + instrumented + "\"")
+           && runCommand("\"" + instrumented + "\" < \"" + trainingInput + "\" > " + kNullDevice)
+           && runCommand(cc + " " + flags + " -fprofile-use=\"" + work + "\" -fprofile-correction -Wno-missing-profile"
+                         " -c " + srcFile + " -o \"" + obj + "\"")
+           && runCommand(cc + " \"" + obj + "\" -o \"" + tmp + "\"");
+    filesystem::remove_all(work, ec);
+    if (!ok) {
+        filesystem::remove(tmp, ec);
+        cerr << "Error: profile-guided build failed\n";
+        return false;
+    }
+    if (!publish(tmp, cached)) return false;
+    pruneBuildCache(kBuildCacheLimit);
+    return copyOut(cached, exe);
+}
+
+int main(int argc, char* argv[]) {
     const string inputFile = "input.txt";
 
+    // Backend selection: C++ (default) or plain C; --table asks for the
+    // table-driven C program when the script qualifies, --fold precomputes
+    // the output, --no-reroll keeps one statement per script line,
+    // --outline moves dekhao repeated often enough into shared helpers
+    // --build compiles the result; --pgo=<file> does a profile-guided
+    // build trained on <file> as the program's stdin
+    // --jit runs the script in-process, --jit-object=<file> writes an object
+    bool cBackend = false;
+    bool tableMode = false;
+    bool foldMode = false;
+    bool rerollLoops = true;
+    bool outlinePrints = false;
+    bool build = false;
+    bool jit = false;
+    string trainingInput, jitObject;
+    for (int a = 1; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "--backend=c")   cBackend = true;
+        if (arg == "--backend=cpp") cBackend = false;
+        if (arg == "--table")       tableMode = true;
+        if (arg == "--fold")        foldMode = true;
+        if (arg == "--no-reroll")   rerollLoops = false;
+        if (arg == "--outline")     outlinePrints = true;
+        if (arg == "--build")       build = true;
+        if (arg.rfind("--pgo=", 0) == 0) { trainingInput = arg.substr(6); build = true; }
+        if (arg == "--jit")         jit = true;
+        if (arg.rfind("--jit-object=", 0) == 0) { jitObject = arg.substr(13); jit = true; }
+    }
+
     // 1) Tokenize
     auto tokens = tokenizeFile(inputFile);
     if (tokens.empty()) {
@@ -246,21 +1754,50 @@ int main() {
     }
     cout << "\n\n";
 
-    // 3) Transpile to C++
-    string cppCode = transpile(tokens);
+    // 3) Transpile
+    Program prog = parseProgram(tokens);
+    if (jit) {
+        if (jitObject.empty()) cout << "===== Output (libgccjit) =====\n";
+        if (!jitProgram(prog, jitObject)) return 1;
+        if (!jitObject.empty()) cout << "Written to " << jitObject << "\n";
+        return 0;
+    }
+    string code;
+    if (tableMode) {
+        if (emitTable(prog, code)) cBackend = true;
+        else cout << "Note: script is not table-eligible (integers only); using the regular backend.\n\n";
+    }
+    if (foldMode && code.empty() && !emitFolded(prog, cBackend, code))
+        cout << "Note: script has dynamic values; the C backend cannot fold it partially.\n\n";
+    if (code.empty()) {
+        Program emitted = rerollLoops ? reroll(prog) : prog;
+        if (outlinePrints) emitted = outline(emitted);
+        code = cBackend ? emitC(emitted) : emitCpp(emitted);
+    }
+    string outFile = cBackend ? "generated.c" : "generated.cpp";
 
-    // 4) Show C++ equivalent in console
-    cout << "===== Generated C++ =====\n";
-    cout << cppCode << "\n";
+    // 4) Show generated code in console
+    cout << (cBackend ? "===== Generated C =====\n" : "===== Generated C++ =====\n");
+    cout << code << "\n";
 
     // 5) (Optional) Write to file for convenience
-    ofstream gout("generated.cpp");
+    ofstream gout(outFile);
     if (gout.is_open()) {
-        gout << cppCode;
+        gout << code;
         gout.close();
-        cout << "Written to generated.cpp\n";
+        cout << "Written to " << outFile << "\n";
     } else {
-        cerr << "Warning: could not write generated.cpp\n";
+        cerr << "Warning: could not write " << outFile << "\n";
+    }
+
+    // 6) Build
+    if (build) {
+        if (!trainingInput.empty() && !filesystem::exists(trainingInput)) {
+            cerr << "Error: training input " << trainingInput << " not found\n";
+            return 1;
+        }
+        if (!buildGenerated(outFile, cBackend, trainingInput)) return 1;
+        cout << "Built generated" << kExeSuffix << "\n";
     }
 
     return 0;
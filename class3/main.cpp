@@ -1,8 +1,14 @@
 #include <bits/stdc++.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 // ===== Tokens =====
-enum class TokType {
+enum class TokType : uint8_t {
     KW_INTEGER, KW_DEKHAO, KW_TE,
     IDENT, NUMBER,
     PLUS, MINUS, STAR, SLASH,
@@ -10,386 +16,1863 @@ enum class TokType {
     END
 };
 
-struct Token { TokType type; string lexeme; int line; };
+// ===== Atoms =====
+// Each distinct identifier spelling is stored once and named by a 32-bit
+// atom; everything after the lexer compares and indexes atoms.
+using Atom = uint32_t;
+constexpr Atom NoAtom = UINT32_MAX;
 
-struct LexResult { vector<Token> tokens; vector<string> warnings; };
+class Interner {
+public:
+    Atom intern(string_view s){
+        auto it=index.find(s); if (it!=index.end()) return it->second;
+        spellings.emplace_back(s); Atom a=Atom(spellings.size()-1);
+        index.emplace(spellings.back(),a); return a;
+    }
+    const string& str(Atom a) const { return spellings[a]; }
+    size_t size() const { return spellings.size(); }
+private:
+    deque<string> spellings;                 // deque: stable addresses for the views in index
+    unordered_map<string_view,Atom> index;
+};
+static Interner atoms;  // shared by Lexer, Parser and Semantic
+
+// The lexeme is source[off, off+len). Offsets are 32-bit, so inputs of
+// kMaxSourceBytes or more are turned away before lexing.
+struct Token { TokType type; uint32_t off, len; int line; };
+static_assert(sizeof(Token)==16, "Token should stay compact");
+constexpr uint64_t kMaxSourceBytes = uint64_t(UINT32_MAX)+1;
+
+// ===== Keywords =====
+// Case-insensitive. Add a row to extend the language; the perfect hash below
+// is recomputed at compile time.
+struct Keyword { string_view text; TokType type; const char* warning; };
+constexpr Keyword kKeywords[] = {
+    {"integer",  TokType::KW_INTEGER, nullptr},
+    {"interger", TokType::KW_INTEGER, "'interger' treated as 'integer'."},
+    {"dekhao",   TokType::KW_DEKHAO,  nullptr},
+    {"te",       TokType::KW_TE,      nullptr},
+};
+constexpr size_t kNumKeywords = sizeof(kKeywords)/sizeof(kKeywords[0]);
+constexpr size_t kKwTableSize = 16;  // power of two, > kNumKeywords
+
+constexpr char asciiLower(char c){ return (c>='A'&&c<='Z')? char(c-'A'+'a') : c; }
+
+// Hash on length, first and last character only: O(1) to compute
+constexpr size_t kwHash(string_view w, uint32_t seed){
+    return (w.size()*seed + uint32_t(asciiLower(w.front()))*(seed>>8) + uint32_t(asciiLower(w.back()))) & (kKwTableSize-1);
+}
+
+constexpr bool kwSeedWorks(uint32_t seed){
+    bool used[kKwTableSize] = {};
+    for (auto& k : kKeywords) { size_t h=kwHash(k.text,seed); if (used[h]) return false; used[h]=true; }
+    return true;
+}
+constexpr uint32_t kwFindSeed(){
+    for (uint32_t seed=1; seed<(1u<<16); ++seed) if (kwSeedWorks(seed)) return seed;
+    return 0;
+}
+constexpr uint32_t kKwSeed = kwFindSeed();
+static_assert(kKwSeed!=0, "no perfect hash for the keyword set; grow kKwTableSize");
+
+struct KeywordTable {
+    int8_t slot[kKwTableSize];
+    constexpr KeywordTable() : slot() {
+        for (auto& s : slot) s = -1;
+        for (size_t k=0; k<kNumKeywords; ++k) slot[kwHash(kKeywords[k].text,kKwSeed)] = int8_t(k);
+    }
+};
+constexpr KeywordTable kKeywordTable;
+
+// One probe, then a case-insensitive compare of at most w.size() chars
+static const Keyword* lookupKeyword(string_view w){
+    int k = kKeywordTable.slot[kwHash(w,kKwSeed)];
+    if (k<0 || kKeywords[k].text.size()!=w.size()) return nullptr;
+    for (size_t i=0;i<w.size();++i) if (asciiLower(w[i])!=kKeywords[k].text[i]) return nullptr;
+    return &kKeywords[k];
+}
 
+// ===== Diagnostics =====
+// Warnings and errors are kept as fixed-size records and rendered to text
+// only when printed, so inputs with millions of them do not spend their time
+// building strings nobody reads. Annotations store the same codes, so only
+// the expression ones (up to NotInt) may appear on a node.
+enum class Diag : uint8_t { None, Undeclared, DivByZero, NotInt, Keyword, UnknownChar, Redeclaration, OutOfRange };
+
+struct Diagnostic {
+    Diag code; int line;
+    uint32_t arg;   // Keyword: index into kKeywords, UnknownChar: the byte, Redeclaration/Undeclared: Atom
+};
+static_assert(sizeof(Diagnostic)==12, "Diagnostic should stay compact");
+
+static string loc(int ln){ if(!ln) return ""; return "Line "+to_string(ln)+": "; }
+
+static string render(const Diagnostic& d){
+    switch (d.code) {
+    case Diag::None:          break;
+    case Diag::Keyword:       return loc(d.line)+kKeywords[d.arg].warning;
+    case Diag::UnknownChar:   return loc(d.line)+"skipping unknown character '"+string(1,char(d.arg))+"'.";
+    case Diag::Redeclaration: return loc(d.line)+"Redeclaration of '"+atoms.str(d.arg)+"'.";
+    case Diag::Undeclared:    return loc(d.line)+"Use of undeclared identifier '"+atoms.str(d.arg)+"'.";
+    case Diag::DivByZero:     return loc(d.line)+"Division by zero in constant expression.";
+    case Diag::NotInt:        return loc(d.line)+"Type error: operands must be integers.";
+    case Diag::OutOfRange:    return loc(d.line)+"Integer literal out of range.";
+    }
+    return "";
+}
+
+// ===== Source =====
+// The whole input, memory-mapped where possible. Token lexemes are views
+// into it, so it must outlive the Lexer.
+class SourceFile {
+public:
+    bool open(const string& path){
+#ifndef _WIN32
+        int fd=::open(path.c_str(),O_RDONLY); if(fd<0) return false;
+        struct stat st; if(fstat(fd,&st)!=0){ ::close(fd); return false; }
+        len=size_t(st.st_size);
+        if(len){ void* p=mmap(nullptr,len,PROT_READ,MAP_PRIVATE,fd,0); if(p!=MAP_FAILED) mapped=static_cast<const char*>(p); }
+        ::close(fd);
+        if(len && !mapped) return readAll(path);
+        return true;
+#else
+        return readAll(path);
+#endif
+    }
+    ~SourceFile(){
+#ifndef _WIN32
+        if(mapped) munmap(const_cast<char*>(mapped),len);
+#endif
+    }
+    string_view view() const { return mapped? string_view(mapped,len) : string_view(buf); }
+private:
+    const char* mapped=nullptr; size_t len=0; string buf;
+    bool readAll(const string& path){
+        ifstream in(path,ios::binary); if(!in) return false;
+        buf.assign(istreambuf_iterator<char>(in),istreambuf_iterator<char>()); return true;
+    }
+};
+
+// ===== Lexer =====
+// Lexes the whole source into one token array, reused across calls. Every
+// non-blank line ends with an END token, so statements stay one per line.
 class Lexer {
 public:
-    static LexResult lexLine(const string& s, int lineNo) {
-        size_t i = 0; vector<Token> toks; vector<string> warns;
-        auto push = [&](TokType t, string lx){ toks.push_back({t,lx,lineNo}); };
+    vector<Token> tokens;
+    vector<Diagnostic> warnings;
+
+    void lex(string_view s, int firstLine=1) {
+        src=s; tokens.clear(); warnings.clear();
+        tokens.reserve(s.size()/4+16);
+        size_t i = 0; int lineNo = firstLine; bool content = false;
+        auto push = [&](TokType t, size_t off, size_t n){ tokens.push_back({t,uint32_t(off),uint32_t(n),lineNo}); };
         auto isIdStart = [](char c){ return isalpha((unsigned char)c) || c=='_'; };
         auto isId = [](char c){ return isalnum((unsigned char)c) || c=='_'; };
 
         while (i < s.size()) {
             char c = s[i];
+            if (c=='\n') { if (content) push(TokType::END,i,0); content=false; ++lineNo; ++i; continue; }
+            if (c!=' ' && c!='\t' && c!='\r') content = true;
             if (isspace((unsigned char)c)) { ++i; continue; }
             if (isdigit((unsigned char)c)) {
                 size_t j=i; while (j<s.size() && isdigit((unsigned char)s[j])) ++j;
-                push(TokType::NUMBER, s.substr(i,j-i)); i=j; continue;
+                push(TokType::NUMBER,i,j-i); i=j; continue;
             }
             if (isIdStart(c)) {
                 size_t j=i; while (j<s.size() && isId(s[j])) ++j;
-                string w = s.substr(i,j-i), lw=w; for (auto& ch:lw) ch=tolower(ch);
-                if (lw=="integer"||lw=="interger"){ if(lw=="interger") warns.push_back("Line "+to_string(lineNo)+": 'interger' treated as 'integer'."); push(TokType::KW_INTEGER,w);}
-                else if (lw=="dekhao") push(TokType::KW_DEKHAO,w);
-                else if (lw=="te") push(TokType::KW_TE,w);
-                else push(TokType::IDENT,w);
+                string_view w(s.data()+i, j-i);
+                if (const Keyword* kw = lookupKeyword(w)) {
+                    if (kw->warning) warnings.push_back({Diag::Keyword, lineNo, uint32_t(kw-kKeywords)});
+                    push(kw->type,i,j-i);
+                } else push(TokType::IDENT,i,j-i);
                 i=j; continue;
             }
             switch(c){
-                case '+': push(TokType::PLUS,"+"); break;
-                case '-': push(TokType::MINUS,"-"); break;
-                case '*': push(TokType::STAR,"*"); break;
-                case '/': push(TokType::SLASH,"/"); break;
-                case '(': push(TokType::LPAREN,"("); break;
-                case ')': push(TokType::RPAREN,")"); break;
-                default: warns.push_back("Line "+to_string(lineNo)+": skipping unknown character '"+string(1,c)+"'."); break;
+                case '+': push(TokType::PLUS,i,1); break;
+                case '-': push(TokType::MINUS,i,1); break;
+                case '*': push(TokType::STAR,i,1); break;
+                case '/': push(TokType::SLASH,i,1); break;
+                case '(': push(TokType::LPAREN,i,1); break;
+                case ')': push(TokType::RPAREN,i,1); break;
+                default: warnings.push_back({Diag::UnknownChar, lineNo, uint32_t((unsigned char)c)}); break;
             }
             ++i;
         }
-        toks.push_back({TokType::END,"",lineNo});
-        return {toks,warns};
+        if (content) push(TokType::END,s.size(),0);
     }
+
+    string_view text(const Token& t) const { return src.substr(t.off,t.len); }
+
+private:
+    string_view src;
 };
 
 // ===== AST =====
-struct Node { virtual ~Node()=default; int line=0; };
-
-struct Expr : Node {};
-struct Stmt : Node {};
+// Every node lives in one arena and refers to its children by 32-bit index,
+// so a program is a few contiguous allocations, freed all at once.
+enum class NodeKind : uint8_t { Number, Ident, Binary, Decl, Print };
+enum class BinOp : uint8_t { Add, Sub, Mul, Div };
 
-struct Number : Expr { int value; explicit Number(int v){value=v;} };
-struct Ident  : Expr { string name; explicit Ident(string n){name=std::move(n);} };
+using NodeId = uint32_t;
+constexpr NodeId NoNode = UINT32_MAX;
 
-struct Binary : Expr {
-    string op; unique_ptr<Expr> left, right;
-    Binary(string o, unique_ptr<Expr> l, unique_ptr<Expr> r)
-        : op(std::move(o)), left(std::move(l)), right(std::move(r)) {}
+struct Node {
+    NodeKind kind; BinOp op; int line;      // expressions: line of first occurrence
+    union { NodeId lhs; Atom name; };       // Binary/Print: lhs (Print: the expr), Ident/Decl: name
+    NodeId rhs;                              // Binary
+    int value;                               // Number/Decl
 };
+static_assert(sizeof(Node)==20, "Node should stay compact");
 
-struct Decl : Stmt {
-    string name; int value;
-    Decl(string n,int v){name=std::move(n); value=v;}
+static const char* opStr(BinOp o){ static const char* s[]={"+","-","*","/"}; return s[(int)o]; }
+
+// Expressions are hash-consed: the same (kind, op, children / value / atom)
+// always gives back the same id, so the arena is a DAG in which repeated
+// subexpressions are stored, annotated and folded once. Children are always
+// created first, so ids are a topological order. Statements are never shared.
+struct AST {
+    vector<Node> nodes;
+    vector<NodeId> program;   // statement roots, in source order
+    vector<NodeId> cons;      // open addressing over expression ids, NoNode = free
+    size_t consed=0;
+
+    static Node make(NodeKind k,int line){ Node n{}; n.kind=k; n.line=line; n.lhs=n.rhs=NoNode; return n; }
+    NodeId add(const Node& n){ nodes.push_back(n); return NodeId(nodes.size()-1); }
+    NodeId number(int v,int line){ Node n=make(NodeKind::Number,line); n.value=v; return share(n); }
+    NodeId ident(Atom nm,int line){ Node n=make(NodeKind::Ident,line); n.name=nm; return share(n); }
+    NodeId binary(BinOp o,NodeId l,NodeId r,int line){ Node n=make(NodeKind::Binary,line); n.op=o; n.lhs=l; n.rhs=r; return share(n); }
+    NodeId decl(Atom nm,int v,int line){ Node n=make(NodeKind::Decl,line); n.name=nm; n.value=v; return add(n); }
+    NodeId print(NodeId e,int line){ Node n=make(NodeKind::Print,line); n.lhs=e; return add(n); }
+
+    const Node& operator[](NodeId id) const { return nodes[id]; }
+    const string& nameOf(NodeId id) const { return atoms.str(nodes[id].name); }
+    void clear(){ nodes.clear(); program.clear(); cons.clear(); consed=0; }
+
+    // everything but the line
+    static bool same(const Node& a,const Node& b){ return a.kind==b.kind && a.op==b.op && a.lhs==b.lhs && a.rhs==b.rhs && a.value==b.value; }
+    static size_t hashOf(const Node& n){
+        uint64_t h = (uint64_t(n.kind)<<8 | uint64_t(n.op)) * 0x9E3779B97F4A7C15ull;
+        h = (h ^ n.lhs) * 0x9E3779B97F4A7C15ull;
+        h = (h ^ n.rhs) * 0x9E3779B97F4A7C15ull;
+        h = (h ^ uint32_t(n.value)) * 0x9E3779B97F4A7C15ull;
+        return size_t(h ^ (h>>29));
+    }
+    NodeId share(const Node& n){
+        if ((consed+1)*2 > cons.size()) {
+            vector<NodeId> old(max<size_t>(64, cons.size()*2), NoNode); old.swap(cons);
+            for (NodeId id: old) if (id!=NoNode) {
+                size_t m=cons.size()-1, h=hashOf(nodes[id])&m;
+                while (cons[h]!=NoNode) h=(h+1)&m;
+                cons[h]=id;
+            }
+        }
+        size_t m=cons.size()-1, h=hashOf(n)&m;
+        for (;; h=(h+1)&m) {
+            NodeId id=cons[h];
+            if (id==NoNode){ ++consed; return cons[h]=add(n); }
+            if (same(nodes[id],n)) return id;
+        }
+    }
 };
 
-struct Print : Stmt {
-    unique_ptr<Expr> expr; explicit Print(unique_ptr<Expr> e):expr(std::move(e)){}
+// ===== Visitor =====
+// The single switch on the node tag. Derived supplies visitNumber/visitIdent/
+// visitBinary/visitDecl/visitPrint and the calls bind statically (CRTP).
+// visit handles one node; walkers keep their own worklists rather than
+// recursing, so a million-deep expression cannot exhaust the stack.
+template<class Derived, class R, class... Args>
+struct ASTVisitor {
+    R visit(NodeId id, Args... args){
+        Derived& d = static_cast<Derived&>(*this);
+        const Node& n = d.ast[id];
+        switch (n.kind) {
+        case NodeKind::Number: return d.visitNumber(id, n, args...);
+        case NodeKind::Ident:  return d.visitIdent(id, n, args...);
+        case NodeKind::Binary: return d.visitBinary(id, n, args...);
+        case NodeKind::Decl:   return d.visitDecl(id, n, args...);
+        case NodeKind::Print:  return d.visitPrint(id, n, args...);
+        }
+        return d.visitDecl(id, n, args...); // unreachable
+    }
 };
 
 // ===== Parser =====
+// Walks the lexer's token array one line (statement) at a time
 class Parser {
 public:
-    explicit Parser(const vector<Token>& t) : toks(t) {}
-    unique_ptr<Stmt> parseStatement(string& err) {
+    vector<Diagnostic> errors;   // literals out of range; parsing goes on
+
+    Parser(const Lexer& l, AST& a, Interner& n=atoms) : lx(l), toks(l.tokens), ast(a), names(n) {}
+    NodeId parseStatement(string& err) {
         if (match(TokType::KW_INTEGER)) return parseDecl(err);
         if (match(TokType::KW_DEKHAO))  return parsePrint(err);
-        err = here()+"Expected 'integer' or 'dekhao'."; return nullptr;
+        err = here()+"Expected 'integer' or 'dekhao'."; return NoNode;
     }
     bool atEnd() const { return peek().type==TokType::END; }
+    bool done() const { return i>=toks.size(); }
+    size_t pos() const { return i; }
+    void nextLine(){ while (!done() && toks[i].type!=TokType::END) ++i; if (!done()) ++i; }
 private:
-    const vector<Token>& toks; size_t i=0;
-    const Token& peek(size_t k=0) const { return toks[min(i+k, toks.size()-1)]; }
-    bool check(TokType t,size_t k=0) const { return peek(k).type==t; }
+    const Lexer& lx; const vector<Token>& toks; AST& ast; Interner& names; size_t i=0;
+    const Token& peek() const { return toks[i]; }
+    bool check(TokType t) const { return peek().type==t; }
     const Token& advance(){ if(!atEnd()) ++i; return toks[i-1]; }
     bool match(TokType t){ if(check(t)){ advance(); return true; } return false; }
     string here() const { return "Line "+to_string(peek().line)+": "; }
+    // A literal that does not fit an int is an error, read as INT_MAX so
+    // the rest of the statement still parses (and folds without new errors)
+    int number(const Token& t){
+        int v=0; string_view d=lx.text(t);
+        if (from_chars(d.data(),d.data()+d.size(),v).ec!=errc{}) { errors.push_back({Diag::OutOfRange, t.line, 0}); return INT_MAX; }
+        return v;
+    }
+    static BinOp opOf(TokType t){ return t==TokType::PLUS?BinOp::Add : t==TokType::MINUS?BinOp::Sub : t==TokType::STAR?BinOp::Mul : BinOp::Div; }
 
-    unique_ptr<Stmt> parseDecl(string& err){
-        if(!check(TokType::IDENT)){ err=here()+"Expected identifier after 'integer'."; return nullptr; }
-        auto idTok=advance(); string name=idTok.lexeme;
-        if(!match(TokType::KW_TE)){ err=here()+"Expected 'te' after identifier."; return nullptr; }
-        if(!check(TokType::NUMBER)){ err=here()+"Expected integer literal after 'te'."; return nullptr; }
-        int val=stoi(advance().lexeme);
-        auto d=make_unique<Decl>(name,val); d->line=idTok.line;
-        if(!atEnd()){ err=here()+"Unexpected tokens after declaration."; return nullptr; }
-        return d;
-    }
-    unique_ptr<Stmt> parsePrint(string& err){
+    NodeId parseDecl(string& err){
+        if(!check(TokType::IDENT)){ err=here()+"Expected identifier after 'integer'."; return NoNode; }
+        auto& idTok=advance(); Atom name=names.intern(lx.text(idTok));
+        if(!match(TokType::KW_TE)){ err=here()+"Expected 'te' after identifier."; return NoNode; }
+        if(!check(TokType::NUMBER)){ err=here()+"Expected integer literal after 'te'."; return NoNode; }
+        int val=number(advance());
+        if(!atEnd()){ err=here()+"Unexpected tokens after declaration."; return NoNode; }
+        return ast.decl(name,val,idTok.line);
+    }
+    NodeId parsePrint(string& err){
         int ln=peek().line;
-        if(!match(TokType::LPAREN)){ err=here()+"Expected '(' after 'dekhao'."; return nullptr; }
-        auto e=parseExpr(err); if(!e) return nullptr;
-        if(!match(TokType::RPAREN)){ err=here()+"Expected ')' after expression."; return nullptr; }
-        if(!atEnd()){ err=here()+"Unexpected tokens after print statement."; return nullptr; }
-        auto p=make_unique<Print>(std::move(e)); p->line=ln; return p;
+        if(!match(TokType::LPAREN)){ err=here()+"Expected '(' after 'dekhao'."; return NoNode; }
+        NodeId e=parseExpr(err); if(e==NoNode) return NoNode;
+        if(!match(TokType::RPAREN)){ err=here()+"Expected ')' after expression."; return NoNode; }
+        if(!atEnd()){ err=here()+"Unexpected tokens after print statement."; return NoNode; }
+        return ast.print(e,ln);
     }
 
-    unique_ptr<Expr> parseExpr(string& err){
-        auto left=parseTerm(err); if(!left) return nullptr;
-        while(check(TokType::PLUS)||check(TokType::MINUS)){
-            string op=advance().lexeme;
-            auto right=parseTerm(err); if(!right) return nullptr;
-            auto n=make_unique<Binary>(op,std::move(left),std::move(right)); n->line=peek().line; left=std::move(n);
+    // Operator precedence with explicit stacks, so nesting depth is bounded by
+    // memory rather than the call stack. Nodes are built in the same order
+    // and errors reported at the same token as by recursive descent.
+    vector<NodeId> vals; vector<TokType> ops;   // ops: operators and LPAREN markers
+    static int prec(TokType t){ return t==TokType::PLUS||t==TokType::MINUS? 1 : t==TokType::STAR||t==TokType::SLASH? 2 : 0; }
+    void reduce(){
+        NodeId r=vals.back(); vals.pop_back();
+        vals.back()=ast.binary(opOf(ops.back()),vals.back(),r,peek().line); ops.pop_back();
+    }
+    NodeId parseExpr(string& err){
+        vals.clear(); ops.clear();
+        for(;;){
+            while(match(TokType::LPAREN)) ops.push_back(TokType::LPAREN);
+            if(check(TokType::IDENT)){ auto t=advance(); vals.push_back(ast.ident(names.intern(lx.text(t)),t.line)); }
+            else if(check(TokType::NUMBER)){ auto t=advance(); vals.push_back(ast.number(number(t),t.line)); }
+            else { err=here()+"Expected identifier, number, or '('."; return NoNode; }
+            for(;;){
+                if(int p=prec(peek().type)){
+                    while(!ops.empty() && prec(ops.back())>=p) reduce();
+                    ops.push_back(advance().type); break;
+                }
+                while(!ops.empty() && ops.back()!=TokType::LPAREN) reduce();
+                if(ops.empty()) return vals.back();
+                if(!match(TokType::RPAREN)){ err=here()+"Expected ')'."; return NoNode; }
+                ops.pop_back();
+            }
         }
-        return left;
     }
-    unique_ptr<Expr> parseTerm(string& err){
-        auto left=parseFactor(err); if(!left) return nullptr;
-        while(check(TokType::STAR)||check(TokType::SLASH)){
-            string op=advance().lexeme;
-            auto right=parseFactor(err); if(!right) return nullptr;
-            auto n=make_unique<Binary>(op,std::move(left),std::move(right)); n->line=peek().line; left=std::move(n);
+};
+
+// ===== Front end =====
+// Runs fn(0..n-1) on `jobs` worker threads pulling indices from a shared counter
+template<class F> static void parallelFor(size_t n, int jobs, F fn){
+    atomic<size_t> next{0};
+    auto worker=[&]{ for (size_t k; (k=next.fetch_add(1))<n; ) fn(k); };
+    vector<thread> pool;
+    for (int t=1; t<jobs; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th: pool) th.join();
+}
+
+// A run of whole lines, lexed and parsed on its own. In parallel mode each
+// chunk has its own arena and atoms, merged into the global ones afterwards.
+struct Chunk {
+    string_view text; int firstLine=1;
+    Lexer lexer; AST ast; Interner names;
+    vector<Diagnostic> errors;   // from the parser
+    size_t parsed=0; bool failed=false; string err;
+
+    void run(AST& into, Interner& atomsInto){
+        lexer.lex(text, firstLine);
+        Parser P(lexer, into, atomsInto);
+        while (!P.done()) {
+            NodeId stmt = P.parseStatement(err);
+            if (stmt==NoNode){ failed=true; break; }
+            into.program.push_back(stmt); ++parsed;
+            P.nextLine();
         }
-        return left;
+        errors=move(P.errors);
     }
-    unique_ptr<Expr> parseFactor(string& err){
-        if(check(TokType::IDENT)){ auto t=advance(); auto e=make_unique<Ident>(t.lexeme); e->line=t.line; return e; }
-        if(check(TokType::NUMBER)){ auto t=advance(); auto e=make_unique<Number>(stoi(t.lexeme)); e->line=t.line; return e; }
-        if(match(TokType::LPAREN)){ auto e=parseExpr(err); if(!e) return nullptr; if(!match(TokType::RPAREN)){ err=here()+"Expected ')'."; return nullptr; } return e; }
-        err=here()+"Expected identifier, number, or '('."; return nullptr;
+
+    // Token listing up to and including the failing line, as the serial
+    // front end prints it; false after a syntax error
+    bool report() const {
+        const auto& t = lexer.tokens;
+        size_t k=0;
+        for (size_t line=0; line<parsed+(failed?1:0); ++line, ++k)
+            for (; t[k].type!=TokType::END; ++k) cout<<"Line "<<t[k].line<<" -> "<<lexer.text(t[k])<<"\n";
+        if (failed){ cerr<<"Syntax error: "<<err<<"\n"; return false; }
+        return true;
     }
 };
 
+// Splits at newlines into about 4 chunks per job, lexes and parses them in
+// parallel (tokens, if asked for, are collected for the cache; parser
+// errors go to `errors`), then
+// rebuilds each chunk's nodes in `ast` in source order with atoms remapped,
+// hash-consing them again so that expressions repeated across chunks are
+// shared too. Returns false on a syntax error.
+static bool parseParallel(string_view src, int jobs, AST& ast, vector<Diagnostic>& warnings, vector<Diagnostic>& errors,
+                          vector<Token>* tokens=nullptr){
+    size_t want = size_t(jobs)*4, target = max<size_t>(src.size()/want, 1);
+    vector<Chunk> chunks;
+    for (size_t b=0; b<src.size(); ) {
+        size_t e = min(src.size(), b+target);
+        while (e<src.size() && src[e-1]!='\n') ++e;
+        chunks.emplace_back(); chunks.back().text = src.substr(b, e-b);
+        b = e;
+    }
+
+    // line numbers first: the lexer bakes them into tokens and warnings
+    vector<int> newlines(chunks.size());
+    parallelFor(chunks.size(), jobs, [&](size_t c){ newlines[c]=int(count(chunks[c].text.begin(), chunks[c].text.end(), '\n')); });
+    for (size_t c=1; c<chunks.size(); ++c) chunks[c].firstLine = chunks[c-1].firstLine + newlines[c-1];
+
+    parallelFor(chunks.size(), jobs, [&](size_t c){ chunks[c].run(chunks[c].ast, chunks[c].names); });
+
+    cout<<"=== Lexical Tokens ===\n";
+    for (size_t c=0; c<chunks.size(); ++c) {
+        if (!chunks[c].report()) return false;
+        warnings.insert(warnings.end(), chunks[c].lexer.warnings.begin(), chunks[c].lexer.warnings.end());
+        errors.insert(errors.end(), chunks[c].errors.begin(), chunks[c].errors.end());
+        if (tokens) {   // rebased onto the whole source
+            uint32_t base=uint32_t(chunks[c].text.data()-src.data());
+            for (Token t: chunks[c].lexer.tokens) if (t.type!=TokType::END) { t.off+=base; tokens->push_back(t); }
+        }
+    }
+
+    vector<vector<Atom>> remap(chunks.size());
+    for (size_t c=0; c<chunks.size(); ++c)
+        for (Atom a=0; a<chunks[c].names.size(); ++a) remap[c].push_back(atoms.intern(chunks[c].names.str(a)));
+
+    vector<NodeId> id;
+    for (size_t c=0; c<chunks.size(); ++c) {
+        const auto& from = chunks[c].ast.nodes;
+        id.resize(from.size());
+        for (size_t k=0; k<from.size(); ++k) {
+            const Node& n = from[k];
+            switch (n.kind) {
+            case NodeKind::Number: id[k]=ast.number(n.value,n.line); break;
+            case NodeKind::Ident:  id[k]=ast.ident(remap[c][n.name],n.line); break;
+            case NodeKind::Binary: id[k]=ast.binary(n.op,id[n.lhs],id[n.rhs],n.line); break;
+            case NodeKind::Decl:   id[k]=ast.decl(remap[c][n.name],n.value,n.line); break;
+            case NodeKind::Print:  id[k]=ast.print(id[n.lhs],n.line); break;
+            }
+        }
+        for (NodeId r: chunks[c].ast.program) ast.program.push_back(id[r]);
+    }
+    return true;
+}
+
 // ===== Semantic annotations =====
-enum class Type { Int, Unknown };
+enum class Type : uint8_t { Int, Unknown };
 
+// One per node, stored densely by NodeId. A shared expression node carries
+// its diagnostic as a code; the text is rendered per occurrence.
 struct Annotation {
-    Type type = Type::Unknown;
-    bool isConst = false;
-    long long constVal = 0;
-    const Decl* resolvedDecl = nullptr; // for identifiers
+    long long constVal;
+    NodeId resolvedDecl;  // for identifiers
+    Type type : 1;
+    bool isConst : 1;
+    bool analyzed : 1;
+    Diag diag : 3;        // raised by this node itself
+    bool tainted : 1;     // this node or a descendant raised one
+    Annotation() : constVal(0), resolvedDecl(NoNode), type(Type::Unknown), isConst(false), analyzed(false),
+                   diag(Diag::None), tainted(false) {}
 };
+static_assert(sizeof(Annotation)==16, "Annotation should stay compact");
 
-struct Semantic {
-    unordered_map<const Node*, Annotation> ann;
-    unordered_map<string, const Decl*> sym;  // single global scope
-    vector<string> errors;
-    vector<string> notes;
-
-    void analyze(vector<unique_ptr<Stmt>>& prog) {
-        // 1) collect decls
-        for (auto& s: prog) if (auto d = dynamic_cast<Decl*>(s.get())) {
-            if (sym.count(d->name)) {
-                errors.push_back(loc(d)+"Redeclaration of '"+d->name+"'.");
-            } else sym[d->name] = d;
-            Annotation A; A.type=Type::Int; A.isConst=true; A.constVal=d->value;
-            ann[d]=A;
-        }
-
-        // 2) analyze statements
-        for (auto& s: prog) {
-            if (auto p = dynamic_cast<Print*>(s.get())) {
-                analyzeExpr(p->expr.get());
-                // print node annotation: type must be Int
-                Annotation A; A.type = get(p->expr.get()).type;
-                A.isConst = get(p->expr.get()).isConst;
-                if (A.isConst) A.constVal = get(p->expr.get()).constVal;
-                ann[p]=A;
+static string loc(const AST& ast, NodeId n){ return loc(n!=NoNode? ast[n].line:0); }
+
+// Annotates and folds one expression node from its children's annotations.
+// Children always have smaller ids, so visiting in arena order, or level by
+// level in parallel, finds them done.
+struct ExprAnalyzer : ASTVisitor<ExprAnalyzer, void> {
+    const AST& ast;
+    vector<Annotation>& ann;
+    const vector<NodeId>& sym;
+
+    ExprAnalyzer(const AST& a, vector<Annotation>& an, const vector<NodeId>& sy) : ast(a), ann(an), sym(sy) {}
+
+    void visitNumber(NodeId e, const Node& n){
+        Annotation A; A.type=Type::Int; A.isConst=true; A.constVal=n.value; set(e,A);
+    }
+    void visitIdent(NodeId e, const Node&){
+        Annotation A;
+        NodeId d = sym[ast[e].name];
+        if (d==NoNode) {
+            A.diag=Diag::Undeclared;
+            A.type=Type::Unknown;
+        } else {
+            A.type=Type::Int; A.isConst=true; A.constVal=ast[d].value; A.resolvedDecl=d;
+        }
+        set(e,A);
+    }
+    void visitBinary(NodeId e, const Node& n){
+        const Annotation &L=ann[n.lhs], &R=ann[n.rhs]; Annotation A;
+        if (L.type==Type::Int && R.type==Type::Int) {
+            A.type = Type::Int;
+            // constant fold if both const
+            if (L.isConst && R.isConst) {
+                A.isConst = true;
+                switch (n.op) {
+                case BinOp::Add: A.constVal = L.constVal + R.constVal; break;
+                case BinOp::Sub: A.constVal = L.constVal - R.constVal; break;
+                case BinOp::Mul: A.constVal = L.constVal * R.constVal; break;
+                case BinOp::Div:
+                    if (R.constVal==0) {
+                        A.diag=Diag::DivByZero;
+                        A.isConst=false;
+                    } else A.constVal = L.constVal / R.constVal;
+                    break;
+                }
             }
+        } else {
+            A.type = Type::Unknown;
+            A.diag = Diag::NotInt;
         }
+        A.tainted = L.tainted || R.tainted;
+        set(e,A);
     }
+    // statements are not expressions
+    void visitDecl(NodeId, const Node&){}
+    void visitPrint(NodeId, const Node&){}
 
-    void analyzeExpr(Expr* e){
-        if (ann.count(e)) return;
-        if (auto n = dynamic_cast<Number*>(e)) {
-            Annotation A; A.type=Type::Int; A.isConst=true; A.constVal=n->value; ann[e]=A; return;
-        }
-        if (auto id = dynamic_cast<Ident*>(e)) {
-            Annotation A;
-            auto it = sym.find(id->name);
-            if (it==sym.end()) {
-                errors.push_back(loc(id)+"Use of undeclared identifier '"+id->name+"'.");
-                A.type=Type::Unknown;
-            } else {
-                A.type=Type::Int; A.isConst=true; A.constVal=it->second->value; A.resolvedDecl=it->second;
+    void set(NodeId n, Annotation A){ A.analyzed=true; A.tainted = A.tainted || A.diag!=Diag::None; ann[n]=A; }
+};
+
+struct Semantic {
+    const AST& ast;
+    vector<Annotation> ann;             // indexed by NodeId
+    vector<NodeId> sym;                 // single global scope: Atom -> Decl
+    vector<Diagnostic> errors;          // any from the parser first, then analysis appends
+    vector<Diagnostic> notes;
+
+    explicit Semantic(const AST& a) : ast(a) {}
+
+    // Statement work is cut into contiguous ranges run on `jobs` threads;
+    // each range keeps its own error list and the lists are joined in range
+    // order, so diagnostics match the serial run exactly.
+    void analyze(int jobs=1) {
+        const vector<NodeId>& prog = ast.program;
+        ann.assign(ast.nodes.size(), Annotation{});
+        size_t parts = jobs>1? min(prog.size(), size_t(jobs)*4) : 1; if (!parts) parts=1;
+        auto lo=[&](size_t p){ return prog.size()*p/parts; };
+        vector<vector<Diagnostic>> errs(parts);
+        auto collect=[&]{ for (auto& e: errs) { errors.insert(errors.end(), e.begin(), e.end()); e.clear(); } };
+
+        // 1) collect decls. Statements are laid out in program order, so the
+        // smallest Decl id per atom is the first declaration; an atomic min
+        // makes the winner independent of thread scheduling.
+        vector<atomic<NodeId>> first(atoms.size());
+        for (auto& f: first) f.store(NoNode, memory_order_relaxed);
+        parallelFor(parts, jobs, [&](size_t p){
+            for (size_t i=lo(p); i<lo(p+1); ++i) { NodeId s=prog[i]; if (ast[s].kind==NodeKind::Decl) {
+                atomic<NodeId>& f = first[ast[s].name];
+                NodeId cur = f.load(memory_order_relaxed);
+                while (s<cur && !f.compare_exchange_weak(cur, s, memory_order_relaxed)) {}
+                Annotation A; A.type=Type::Int; A.isConst=true; A.constVal=ast[s].value; A.analyzed=true;
+                ann[s]=A;
+            } }
+        });
+        sym.resize(first.size());
+        for (size_t a=0; a<first.size(); ++a) sym[a]=first[a].load(memory_order_relaxed);
+        parallelFor(parts, jobs, [&](size_t p){
+            for (size_t i=lo(p); i<lo(p+1); ++i) { NodeId s=prog[i];
+                if (ast[s].kind==NodeKind::Decl && sym[ast[s].name]!=s)
+                    errs[p].push_back({Diag::Redeclaration, ast[s].line, ast[s].name});
             }
-            ann[e]=A; return;
-        }
-        if (auto b = dynamic_cast<Binary*>(e)) {
-            analyzeExpr(b->left.get());
-            analyzeExpr(b->right.get());
-            Annotation L=get(b->left.get()), R=get(b->right.get()), A;
-            if (L.type==Type::Int && R.type==Type::Int) {
-                A.type = Type::Int;
-                // constant fold if both const
-                if (L.isConst && R.isConst) {
-                    A.isConst = true;
-                    if (b->op=="+") A.constVal = L.constVal + R.constVal;
-                    else if (b->op=="-") A.constVal = L.constVal - R.constVal;
-                    else if (b->op=="*") A.constVal = L.constVal * R.constVal;
-                    else if (b->op=="/") {
-                        if (R.constVal==0) {
-                            errors.push_back(loc(b)+"Division by zero in constant expression.");
-                            A.isConst=false;
-                        } else A.constVal = L.constVal / R.constVal;
-                    }
-                }
-            } else {
-                A.type = Type::Unknown;
-                errors.push_back(loc(b)+"Type error: operands must be integers.");
+        });
+        collect();
+
+        // 2) analyze each unique expression once, in arena order
+        ExprAnalyzer X(ast, ann, sym);
+        if (jobs>1) {
+            // level = height above the leaves; a level only reads lower ones
+            vector<uint32_t> level(ast.nodes.size(), 0), start(1, 0);
+            for (NodeId e=0; e<ast.nodes.size(); ++e) {
+                const Node& n=ast[e];
+                if (n.kind==NodeKind::Binary) level[e]=max(level[n.lhs],level[n.rhs])+1;
+                if (level[e]+2>start.size()) start.resize(level[e]+2, 0);
+                ++start[level[e]+1];
             }
-            ann[e]=A; return;
+            partial_sum(start.begin(), start.end(), start.begin());
+            vector<NodeId> order(ast.nodes.size());
+            { vector<uint32_t> at(start); for (NodeId e=0; e<ast.nodes.size(); ++e) order[at[level[e]]++]=e; }
+            for (size_t l=0; l+1<start.size(); ++l) {
+                size_t b=start[l], n=start[l+1]-b, grain=4096;
+                parallelFor((n+grain-1)/grain, jobs, [&](size_t g){
+                    for (size_t k=b+g*grain; k<b+min(n,(g+1)*grain); ++k) X.visit(order[k]);
+                });
+            }
+        } else {
+            for (NodeId e=0; e<ast.nodes.size(); ++e) X.visit(e);
+        }
+
+        // 3) annotate statements and render diagnostics in statement order
+        parallelFor(parts, jobs, [&](size_t p){
+            for (size_t i=lo(p); i<lo(p+1); ++i) { NodeId s=prog[i];
+                if (ast[s].kind==NodeKind::Print) { annotatePrint(s); report(ast[s].lhs, ast[s].line, errs[p]); }
+            }
+        });
+        collect();
+    }
+
+    // print node annotation: type must be Int
+    void annotatePrint(NodeId s){
+        NodeId e = ast[s].lhs;
+        Annotation A; A.type = ann[e].type;
+        A.isConst = ann[e].isConst;
+        if (A.isConst) A.constVal = ann[e].constVal;
+        A.analyzed = true; ann[s]=A;
+    }
+
+    // Diagnostics under `e` in evaluation (post-)order, placed at statement
+    // line `ln`. Only tainted subtrees are entered, so clean statements cost O(1).
+    void report(NodeId root, int ln, vector<Diagnostic>& out) const {
+        if (!ann[root].tainted) return;
+        vector<pair<NodeId,bool>> todo{{root,false}};   // (node, children done)
+        while (!todo.empty()) {
+            auto [e,done] = todo.back(); todo.pop_back();
+            const Annotation& A=ann[e];
+            if (!A.tainted) continue;
+            const Node& n=ast[e];
+            if (!done && n.kind==NodeKind::Binary) { todo.push_back({e,true}); todo.push_back({n.rhs,false}); todo.push_back({n.lhs,false}); continue; }
+            if (A.diag!=Diag::None) out.push_back({A.diag, ln, A.diag==Diag::Undeclared? n.name : 0});
         }
-        // fallback
-        ann[e]=Annotation{};
     }
 
-    const Annotation& get(const Node* n) const {
+    const Annotation& get(NodeId n) const {
         static Annotation empty;
-        auto it=ann.find(n); return it==ann.end()?empty:it->second;
+        return n<ann.size()? ann[n] : empty;
     }
 
     static string tstr(Type t){ return t==Type::Int? "int" : "unknown"; }
+};
 
-    static string loc(const Node* n){
-        int ln = n? n->line:0; if(!ln) return ""; return "Line "+to_string(ln)+": ";
+// ===== Incremental =====
+// --watch keeps one Session and hands it every new version of input.txt.
+// Lines are matched to the previous version by content hash; only new or
+// changed lines are lexed and parsed, and a reused statement just takes its
+// new line number. New nodes, and the uses of every name whose first
+// declaration moved, are re-analyzed through the parents index in id (that
+// is, topological) order, stopping wherever an annotation comes out the
+// same. Nodes of deleted lines are left in the arena until they outweigh
+// the live ones; then compact() rebuilds it.
+struct Session {
+    struct Line {
+        uint64_t hash=0;
+        NodeId stmt=NoNode;      // NoNode: blank, or a syntax error
+        vector<Token> toks;      // non-END, offsets from the line start
+        vector<Diagnostic> warnings, errors;   // errors: from the parser
+        string err;              // rendered with its line number
+    };
+    struct Stats { size_t lines=0, reparsed=0, reanalyzed=0; };
+
+    AST ast;
+    Semantic sem{ast};
+    vector<Line> lines;
+    vector<size_t> start;                  // offset of each line in the current source
+    vector<Diagnostic> warnings;
+    size_t failedAt=SIZE_MAX;              // first line with a syntax error
+
+    static uint64_t hashOf(string_view s){
+        uint64_t h=1469598103934665603ull;
+        for (unsigned char c: s) { h^=c; h*=1099511628211ull; }
+        return h;
+    }
+
+    Stats update(string_view src){
+        Stats st;
+        NodeId firstNew = NodeId(ast.nodes.size());
+        start.clear(); vector<uint64_t> hash;
+        for (size_t b=0; b<src.size(); ) {
+            size_t e=src.find('\n', b); if (e==string_view::npos) e=src.size();
+            start.push_back(b); hash.push_back(hashOf(src.substr(b, e-b))); b=e+1;
+        }
+        // a syntax error names its line, so that line is always redone
+        auto keeps=[&](size_t k){ return lines[k].err.empty(); };
+
+        // 1) an edit usually leaves a common head and tail in place; the
+        // lines in between are matched by hash, wherever they were before
+        size_t O=lines.size(), N=hash.size(), head=0, tail=0;
+        while (head<min(O,N) && lines[head].hash==hash[head] && keeps(head)) ++head;
+        while (tail<min(O,N)-head && lines[O-1-tail].hash==hash[N-1-tail] && keeps(O-1-tail)) ++tail;
+        unordered_multimap<uint64_t,size_t> prev(O-head-tail);
+        for (size_t k=head; k<O-tail; ++k) prev.emplace(lines[k].hash, k);
+
+        vector<Line> mid(N-head-tail);
+        vector<Atom> touched;   // names whose set of declarations changed
+        Lexer lx;
+        for (size_t i=head; i<N-tail; ++i) {
+            Line& L=mid[i-head];
+            auto it=prev.find(hash[i]);
+            if (it!=prev.end() && keeps(it->second)) { L=move(lines[it->second]); prev.erase(it); continue; }
+            string_view text=src.substr(start[i], min(src.find('\n', start[i]), src.size())-start[i]);
+            L.hash=hash[i]; ++st.reparsed;
+            lx.lex(text, int(i)+1);
+            L.warnings=lx.warnings;
+            for (auto& t: lx.tokens) if (t.type!=TokType::END) L.toks.push_back(t);
+            if (!lx.tokens.empty()) {
+                Parser P(lx, ast);
+                L.stmt=P.parseStatement(L.err);
+                L.errors=move(P.errors);
+                if (L.stmt!=NoNode && ast[L.stmt].kind==NodeKind::Decl) touched.push_back(ast[L.stmt].name);
+            }
+        }
+        size_t n=ast.nodes.size();
+        sem.ann.resize(n); parents.resize(n); pos.resize(n, 0); live.resize(n, 0); queued.resize(n, 0);
+        sem.sym.resize(atoms.size(), NoNode); identOf.resize(atoms.size(), NoNode); declsOf.resize(atoms.size());
+
+        // 2) whatever was not reused is gone
+        for (auto& [h,k]: prev) {
+            NodeId s=lines[k].stmt;
+            if (s==NoNode) continue;
+            live[s]=0;
+            ++dead;
+            if (ast[s].kind==NodeKind::Decl) {
+                Atom a=ast[s].name; auto& v=declsOf[a];
+                v.erase(find(v.begin(), v.end(), s));
+                if (v.size()==1) redeclared.erase(a);
+                touched.push_back(a);
+            }
+        }
+        // splice the middle in; the tail only moves when the count changed
+        if (N==O) move(mid.begin(), mid.end(), lines.begin()+head);
+        else {
+            lines.erase(lines.begin()+head, lines.begin()+(O-tail));
+            lines.insert(lines.begin()+head, make_move_iterator(mid.begin()), make_move_iterator(mid.end()));
+        }
+        for (size_t i=head; i<(N==O? N-tail : N); ++i) {
+            if (lines[i].stmt!=NoNode) ast.nodes[lines[i].stmt].line=int(i)+1;
+            for (auto& w: lines[i].warnings) w.line=int(i)+1;
+            for (auto& w: lines[i].errors) w.line=int(i)+1;
+        }
+        st.lines=lines.size();
+
+        // 3) statement order, warnings, first syntax error
+        ast.program.clear(); warnings.clear(); failedAt=SIZE_MAX;
+        for (size_t k=0; k<lines.size(); ++k) {
+            Line& L=lines[k];
+            warnings.insert(warnings.end(), L.warnings.begin(), L.warnings.end());
+            if (!L.err.empty() && failedAt==SIZE_MAX) failedAt=k;
+            if (L.stmt!=NoNode) { pos[L.stmt]=uint32_t(ast.program.size()); ast.program.push_back(L.stmt); live[L.stmt]=1; }
+        }
+
+        // 4) index the new nodes; all of them need analysis
+        priority_queue<NodeId, vector<NodeId>, greater<NodeId>> dirty;
+        auto mark=[&](NodeId e){ if (!queued[e]) { queued[e]=1; dirty.push(e); } };
+        for (NodeId e=firstNew; e<n; ++e) {
+            index(e);
+            if (ast[e].kind==NodeKind::Decl) {
+                Annotation A; A.type=Type::Int; A.isConst=true; A.constVal=ast[e].value; A.analyzed=true;
+                sem.ann[e]=A;
+                auto& v=declsOf[ast[e].name]; v.push_back(e);
+                if (v.size()==2) redeclared.insert(ast[e].name);
+            } else mark(e);
+        }
+
+        // 5) a name resolves to its first declaration by position, which
+        // moved lines can change too when the name is declared twice
+        touched.insert(touched.end(), redeclared.begin(), redeclared.end());
+        for (Atom a: touched) {
+            NodeId first=NoNode;
+            for (NodeId d: declsOf[a]) if (first==NoNode || pos[d]<pos[first]) first=d;
+            if (first!=sem.sym[a]) { sem.sym[a]=first; if (identOf[a]!=NoNode) mark(identOf[a]); }
+        }
+
+        // 6) re-analyze in id order; parents only when something changed
+        ExprAnalyzer X(ast, sem.ann, sem.sym);
+        while (!dirty.empty()) {
+            NodeId e=dirty.top(); dirty.pop(); queued[e]=0; ++st.reanalyzed;
+            if (ast[e].kind==NodeKind::Print) { if (live[e]) sem.annotatePrint(e); continue; }
+            Annotation was=sem.ann[e];
+            X.visit(e);
+            if (e<firstNew && same(was, sem.ann[e])) continue;
+            for (NodeId p: parents[e]) mark(p);
+        }
+
+        // 7) diagnostics, rendered in statement order as Semantic does
+        sem.errors.clear();
+        for (auto& L: lines) sem.errors.insert(sem.errors.end(), L.errors.begin(), L.errors.end());
+        for (NodeId s: ast.program)
+            if (ast[s].kind==NodeKind::Decl && sem.sym[ast[s].name]!=s)
+                sem.errors.push_back({Diag::Redeclaration, ast[s].line, ast[s].name});
+        for (NodeId s: ast.program)
+            if (ast[s].kind==NodeKind::Print) sem.report(ast[s].lhs, ast[s].line, sem.errors);
+
+        // 8) nodes of deleted lines pile up; once they outweigh the live
+        // ones, rebuild the arena so per-node work follows the file again
+        if (ast.nodes.size() > 2*max<size_t>(kept, 4096) || dead > ast.program.size()) compact();
+        return st;
+    }
+
+    // Token listing up to and including the first failing line; false after
+    // a syntax error, like Chunk::report
+    bool report(string_view src) const {
+        size_t upto = failedAt==SIZE_MAX? lines.size() : failedAt+1;
+        for (size_t k=0; k<upto; ++k)
+            for (auto& t: lines[k].toks) cout<<"Line "<<k+1<<" -> "<<src.substr(start[k]+t.off, t.len)<<"\n";
+        if (failedAt!=SIZE_MAX){ cerr<<"Syntax error: "<<lines[failedAt].err<<"\n"; return false; }
+        return true;
+    }
+
+private:
+    vector<vector<NodeId>> parents;   // NodeId -> Binary/Print nodes reading it
+    vector<vector<NodeId>> declsOf;   // Atom -> live Decl statements
+    vector<NodeId> identOf;           // Atom -> its (shared) Ident node: the uses hang off it
+    unordered_set<Atom> redeclared;   // names with more than one live Decl
+    vector<uint32_t> pos;             // statement -> index in program
+    vector<char> live, queued;
+    size_t kept=0, dead=0;            // arena size after the last compact(), statements dropped since
+
+    // parents and identOf entries for one node
+    void index(NodeId e){
+        const Node& nd=ast[e];
+        switch (nd.kind) {
+        case NodeKind::Ident:  identOf[nd.name]=e; break;
+        case NodeKind::Binary:
+            parents[nd.lhs].push_back(e);
+            if (nd.rhs!=nd.lhs) parents[nd.rhs].push_back(e);
+            break;
+        case NodeKind::Print:  parents[nd.lhs].push_back(e); break;
+        default: break;
+        }
+    }
+
+    // Copies the live statements into a fresh arena in the order a fresh
+    // parse creates the nodes (each statement's expression in post-order),
+    // with their annotations, and renumbers everything that holds an id.
+    void compact(){
+        AST out; vector<Annotation> ann;
+        vector<NodeId> to(ast.nodes.size(), NoNode);
+        auto copy=[&](NodeId e, int ln){
+            Node n=ast[e];
+            switch (n.kind) {
+            case NodeKind::Binary: n.lhs=to[n.lhs]; n.rhs=to[n.rhs]; n.line=ln; to[e]=out.share(n); break;
+            case NodeKind::Number: case NodeKind::Ident: n.line=ln; to[e]=out.share(n); break;
+            case NodeKind::Print:  n.lhs=to[n.lhs]; to[e]=out.add(n); break;
+            case NodeKind::Decl:   to[e]=out.add(n); break;
+            }
+            ann.push_back(sem.ann[e]);
+        };
+        vector<pair<NodeId,bool>> todo;   // (node, children done)
+        for (NodeId s: ast.program) {
+            if (ast[s].kind==NodeKind::Print) {
+                todo.push_back({ast[s].lhs,false});
+                while (!todo.empty()) {
+                    auto [e,done] = todo.back(); todo.pop_back();
+                    if (to[e]!=NoNode) continue;
+                    const Node& n=ast[e];
+                    if (!done && n.kind==NodeKind::Binary) { todo.push_back({e,true}); todo.push_back({n.rhs,false}); todo.push_back({n.lhs,false}); continue; }
+                    copy(e, ast[s].line);
+                }
+            }
+            copy(s, ast[s].line);
+        }
+        auto map=[&](NodeId& id){ if (id!=NoNode) id=to[id]; };
+        for (auto& A: ann) map(A.resolvedDecl);
+        for (auto& d: sem.sym) map(d);
+        for (auto& d: identOf) map(d);
+        for (auto& v: declsOf) for (auto& d: v) map(d);
+        for (auto& L: lines) map(L.stmt);
+        out.program.reserve(ast.program.size());
+        for (NodeId s: ast.program) out.program.push_back(to[s]);
+
+        ast=move(out); sem.ann=move(ann);
+        size_t n=ast.nodes.size();
+        parents.assign(n, {}); pos.assign(n, 0); live.assign(n, 0); queued.assign(n, 0);
+        for (NodeId e=0; e<n; ++e) index(e);
+        for (size_t i=0; i<ast.program.size(); ++i) { pos[ast.program[i]]=uint32_t(i); live[ast.program[i]]=1; }
+        kept=n; dead=0;
+    }
+
+    static bool same(const Annotation& a, const Annotation& b){
+        return a.constVal==b.constVal && a.resolvedDecl==b.resolvedDecl && a.type==b.type
+            && a.isConst==b.isConst && a.diag==b.diag && a.tainted==b.tainted;
     }
 };
 
 // ===== Pretty printers =====
-struct ASTPrinter {
-    static void print(const vector<unique_ptr<Stmt>>& program, const Semantic& S) {
+// Pre-order: each visit prints one node and pushes its children (and the
+// "left:"/"right:" captions) onto `work` in reverse. Past kMaxIndent columns
+// the indent is written as a number, so a million-deep chain prints in
+// linear rather than quadratic size.
+struct ASTPrinter : ASTVisitor<ASTPrinter, void, int> {
+    static constexpr int kMaxIndent = 64;
+    const AST& ast; const Semantic& S;
+    struct Item { NodeId e; int indent; const char* caption; };   // caption: a text line instead of a node
+    vector<Item> work;
+    ASTPrinter(const AST& a, const Semantic& s) : ast(a), S(s) {}
+
+    void print() {
         cout << "=== Annotated Semantic Tree ===\n";
-        int i=1; for (auto& s: program) {
+        int i=1; for (NodeId s: ast.program) {
             cout << "Stmt " << i++ << ":\n";
-            printStmt(*s, S, 2);
-        }
-    }
-    static void printStmt(const Stmt& s, const Semantic& S, int indent){
-        string pad(indent,' ');
-        if (auto d = dynamic_cast<const Decl*>(&s)) {
-            auto A=S.get(&s);
-            cout << pad << "Decl(integer)  :: type=" << Semantic::tstr(A.type)
-                 << ", const=" << (A.isConst? "true ("+to_string(A.constVal)+")":"false") << "\n";
-            cout << pad << "  name: " << d->name << "\n";
-            cout << pad << "  value: " << d->value << "\n";
-        } else if (auto p = dynamic_cast<const Print*>(&s)) {
-            auto A=S.get(&s);
-            cout << pad << "Print(dekhao)  :: expr.type=" << Semantic::tstr(A.type);
-            if (A.isConst) cout << ", expr.const=" << A.constVal;
-            cout << "\n";
-            cout << pad << "  expr:\n";
-            printExpr(*p->expr, S, indent+4);
-        }
-    }
-    static void printExpr(const Expr& e, const Semantic& S, int indent){
-        string pad(indent,' ');
-        auto A=S.get(&e);
-        if (auto n = dynamic_cast<const Number*>(&e)) {
-            cout << pad << "Number(" << n->value << ")  :: type=" << Semantic::tstr(A.type)
-                 << ", const=" << (A.isConst? "true ("+to_string(A.constVal)+")":"false") << "\n";
-        } else if (auto id = dynamic_cast<const Ident*>(&e)) {
-            cout << pad << "Ident(" << id->name << ")  :: type=" << Semantic::tstr(A.type);
-            if (A.resolvedDecl) cout << ", binds→" << A.resolvedDecl->name;
-            if (A.isConst) cout << ", const=" << A.constVal;
-            cout << "\n";
-        } else if (auto b = dynamic_cast<const Binary*>(&e)) {
-            cout << pad << "BinaryOp(" << b->op << ")  :: type=" << Semantic::tstr(A.type);
-            if (A.isConst) cout << ", const=" << A.constVal;
-            cout << "\n";
-            cout << pad << "  left:\n";  printExpr(*b->left,  S, indent+4);
-            cout << pad << "  right:\n"; printExpr(*b->right, S, indent+4);
-        } else {
-            cout << pad << "<expr?> :: type=" << Semantic::tstr(A.type) << "\n";
+            work.push_back({s, 2, nullptr});
+            while (!work.empty()) {
+                Item it=work.back(); work.pop_back();
+                if (it.caption) cout << indentStr(it.indent) << it.caption << "\n";
+                else visit(it.e, it.indent);
+            }
         }
     }
+    static string constStr(const Annotation& A){ return A.isConst? "true ("+to_string(A.constVal)+")":"false"; }
+    static string indentStr(int n){ return n<=kMaxIndent? string(n,' ') : string(kMaxIndent,' ')+"["+to_string(n)+"] "; }
+
+    void visitDecl(NodeId s, const Node& n, int indent){
+        string pad=indentStr(indent);
+        auto A=S.get(s);
+        cout << pad << "Decl(integer)  :: type=" << Semantic::tstr(A.type) << ", const=" << constStr(A) << "\n";
+        cout << pad << "  name: " << ast.nameOf(s) << "\n";
+        cout << pad << "  value: " << n.value << "\n";
+    }
+    void visitPrint(NodeId s, const Node& n, int indent){
+        string pad=indentStr(indent);
+        auto A=S.get(s);
+        cout << pad << "Print(dekhao)  :: expr.type=" << Semantic::tstr(A.type);
+        if (A.isConst) cout << ", expr.const=" << A.constVal;
+        cout << "\n";
+        cout << pad << "  expr:\n";
+        work.push_back({n.lhs, indent+4, nullptr});
+    }
+    void visitNumber(NodeId e, const Node& n, int indent){
+        auto A=S.get(e);
+        cout << indentStr(indent) << "Number(" << n.value << ")  :: type=" << Semantic::tstr(A.type)
+             << ", const=" << constStr(A) << "\n";
+    }
+    void visitIdent(NodeId e, const Node&, int indent){
+        auto A=S.get(e);
+        cout << indentStr(indent) << "Ident(" << ast.nameOf(e) << ")  :: type=" << Semantic::tstr(A.type);
+        if (A.resolvedDecl!=NoNode) cout << ", binds→" << ast.nameOf(A.resolvedDecl);
+        if (A.isConst) cout << ", const=" << A.constVal;
+        cout << "\n";
+    }
+    void visitBinary(NodeId e, const Node& n, int indent){
+        string pad=indentStr(indent);
+        auto A=S.get(e);
+        cout << pad << "BinaryOp(" << opStr(n.op) << ")  :: type=" << Semantic::tstr(A.type);
+        if (A.isConst) cout << ", const=" << A.constVal;
+        cout << "\n";
+        work.push_back({n.rhs, indent+4, nullptr}); work.push_back({NoNode, indent, "  right:"});
+        work.push_back({n.lhs, indent+4, nullptr}); work.push_back({NoNode, indent, "  left:"});
+    }
 };
 
 // ===== DOT with annotations =====
-struct DOT {
-    ofstream out; int nextId=0;
-    explicit DOT(const string& path):out(path){ out<<"digraph AnnotatedAST {\n  node [shape=box];\n"; }
-    ~DOT(){ out<<"}\n"; }
-    static string esc(string s){ for(char& c:s) if(c=='"') c='\''; return s; }
-    int node(const string& label){ int id=nextId++; out<<"  n"<<id<<" [label=\""<<esc(label)<<"\"];\n"; return id; }
-    void edge(int a,int b,const string& el=""){ out<<"  n"<<a<<" -> n"<<b; if(!el.empty()) out<<" [label=\""<<esc(el)<<"\"]"; out<<";\n"; }
-
-    int emitStmt(const Stmt& s, const Semantic& S){
-        if (auto d=dynamic_cast<const Decl*>(&s)){
-            auto A=S.get(&s);
-            int r=node("Decl\\n(integer)\\n:type="+Semantic::tstr(A.type)+"\\nconst="+(A.isConst?("true("+to_string(A.constVal)+")"):"false"));
-            int n1=node("name="+d->name), n2=node("value="+to_string(d->value));
-            edge(r,n1); edge(r,n2); return r;
-        } else if (auto p=dynamic_cast<const Print*>(&s)){
-            auto A=S.get(&s);
-            int r=node("Print\\n(dekhao)\\nexpr.type="+Semantic::tstr(A.type)+(A.isConst?("\\nexpr.const="+to_string(A.constVal)):""));
-            int e=emitExpr(*p->expr,S); edge(r,e,"expr"); return r;
-        }
-        return node("<stmt?>");
-    }
-
-    int emitExpr(const Expr& e, const Semantic& S){
-        auto A=S.get(&e);
-        if (auto n=dynamic_cast<const Number*>(&e)) {
-            return node("Number\\n"+to_string(n->value)+"\\n:type="+Semantic::tstr(A.type)+"\\nconst="+(A.isConst?("true("+to_string(A.constVal)+")"):"false"));
-        } else if (auto id=dynamic_cast<const Ident*>(&e)) {
-            string lbl = "Ident\\n"+id->name+"\\n:type="+Semantic::tstr(A.type);
-            if (A.resolvedDecl) lbl += "\\nbinds→"+A.resolvedDecl->name;
-            if (A.isConst) lbl += "\\nconst="+to_string(A.constVal);
-            return node(lbl);
-        } else if (auto b=dynamic_cast<const Binary*>(&e)) {
-            string lbl="BinaryOp\\n"+b->op+"\\n:type="+Semantic::tstr(A.type); if(A.isConst) lbl+="\\nconst="+to_string(A.constVal);
-            int r=node(lbl), L=emitExpr(*b->left,S), R=emitExpr(*b->right,S);
-            edge(r,L,"left"); edge(r,R,"right"); return r;
-        }
-        return node("<expr?>");
+struct DotOptions {
+    int maxDepth=-1;                // --dot-max-depth N: boxes below depth N fold into a summary
+    size_t maxNodes=20000;          // --dot-max-nodes N (0 = no cap); Graphviz stalls well before 1M
+    size_t first=1, last=SIZE_MAX;  // --stmt-range a:b, 1-based and inclusive
+    bool summarize=true;            // --dot-full: draw repeated subtrees out in full
+};
+
+// Streams through its own buffer and escapes labels while copying them.
+// visit draws one node's box (a Decl also its leaves); emit walks the tree
+// with an explicit stack, numbering boxes in pre-order and writing each
+// node's edges once its children are drawn. A Binary subtree already drawn
+// (the DAG shares it) is drawn again only as a dashed reference box.
+struct DOT : ASTVisitor<DOT, int> {
+    const AST& ast; const Semantic& S; DotOptions opt;
+    ofstream out; string buf; int nextId=0;
+    vector<int> drawn;              // NodeId -> its box, -1 = not drawn yet
+    vector<uint64_t> size;          // tree size under each node, saturating
+    struct Frame { NodeId e; int stage, r, l, depth; };
+    vector<Frame> work;
+
+    DOT(const string& path, const AST& a, const Semantic& s, DotOptions o={})
+        : ast(a), S(s), opt(o), out(path, ios::binary), drawn(a.nodes.size(), -1), size(a.nodes.size(), 1) {
+        for (NodeId e=0; e<ast.nodes.size(); ++e) {
+            const Node& n=ast[e];
+            if (n.kind==NodeKind::Binary) size[e]=min<uint64_t>(UINT32_MAX, 1+size[n.lhs]+size[n.rhs]);
+            if (n.kind==NodeKind::Print)  size[e]=1+size[n.lhs];
+        }
+        buf.reserve(1<<17);
+        put("digraph AnnotatedAST {\n  node [shape=box];\n");
+    }
+    ~DOT(){ put("}\n"); flush(); }
+
+    void flush(){ out.write(buf.data(), streamsize(buf.size())); buf.clear(); }
+    void put(string_view s){ buf.append(s); if (buf.size()>=(1<<16)) flush(); }
+    void putInt(long long v){ char t[24]; put(string_view(t, size_t(to_chars(t, t+sizeof t, v).ptr-t))); }
+    void text(string_view s){ for (char c: s) buf.push_back(c=='"'? '\'' : c); if (buf.size()>=(1<<16)) flush(); }
+    void constStr(const Annotation& A){ if (A.isConst){ put("true("); putInt(A.constVal); put(")"); } else put("false"); }
+
+    int open(){ int id=nextId++; put("  n"); putInt(id); put(" [label=\""); return id; }
+    void close(bool dashed=false){ put(dashed? "\", style=dashed];\n" : "\"];\n"); }
+    int node(string_view label){ int id=open(); text(label); close(); return id; }
+    void edge(int a,int b,string_view el=""){
+        put("  n"); putInt(a); put(" -> n"); putInt(b);
+        if (!el.empty()){ put(" [label=\""); text(el); put("\"]"); }
+        put(";\n");
+    }
+    bool capped() const { return opt.maxNodes && size_t(nextId)>=opt.maxNodes; }
+
+    int visitDecl(NodeId s, const Node& n){
+        auto A=S.get(s);
+        int r=open(); put("Decl\\n(integer)\\n:type="); put(Semantic::tstr(A.type)); put("\\nconst="); constStr(A); close();
+        int n1=open(); put("name="); text(ast.nameOf(s)); close();
+        int n2=open(); put("value="); putInt(n.value); close();
+        edge(r,n1); edge(r,n2); return r;
+    }
+    int visitPrint(NodeId s, const Node&){
+        auto A=S.get(s);
+        int r=open(); put("Print\\n(dekhao)\\nexpr.type="); put(Semantic::tstr(A.type));
+        if (A.isConst){ put("\\nexpr.const="); putInt(A.constVal); }
+        close(); return r;
+    }
+    int visitNumber(NodeId e, const Node& n){
+        auto A=S.get(e);
+        int r=open(); put("Number\\n"); putInt(n.value); put("\\n:type="); put(Semantic::tstr(A.type)); put("\\nconst="); constStr(A);
+        close(); return r;
+    }
+    int visitIdent(NodeId e, const Node&){
+        auto A=S.get(e);
+        int r=open(); put("Ident\\n"); text(ast.nameOf(e)); put("\\n:type="); put(Semantic::tstr(A.type));
+        if (A.resolvedDecl!=NoNode){ put("\\nbinds→"); text(ast.nameOf(A.resolvedDecl)); }
+        if (A.isConst){ put("\\nconst="); putInt(A.constVal); }
+        close(); return r;
+    }
+    int visitBinary(NodeId e, const Node& n){
+        auto A=S.get(e);
+        int r=open(); put("BinaryOp\\n"); put(opStr(n.op)); put("\\n:type="); put(Semantic::tstr(A.type));
+        if (A.isConst){ put("\\nconst="); putInt(A.constVal); }
+        close(); return r;
+    }
+    // One dashed box standing for the whole subtree under `e`
+    int summary(NodeId e, int ref){
+        const Node& n=ast[e];
+        int r=open();
+        if (n.kind==NodeKind::Print) put("Print\\n(dekhao)"); else { put("BinaryOp\\n"); put(opStr(n.op)); }
+        if (ref>=0){ put("\\n= n"); putInt(ref); put(" ("); } else put("\\n… (");
+        putInt((long long)size[e]); put(" nodes)");
+        close(true); return r;
+    }
+
+    // Returns the box id of `root`, drawn at `depth` below the Program box
+    int emit(NodeId root, int depth=1){
+        work.push_back({root,0,-1,-1,depth}); int ret=-1;
+        while (!work.empty()) {
+            Frame& f=work.back(); const Node& n=ast[f.e];
+            bool inner = n.kind==NodeKind::Binary || n.kind==NodeKind::Print;
+            switch (f.stage++) {
+            case 0:
+                if (inner && ((opt.maxDepth>=0 && f.depth>=opt.maxDepth) || capped())) { f.r=summary(f.e,-1); break; }
+                if (n.kind==NodeKind::Binary && opt.summarize && drawn[f.e]>=0) { f.r=summary(f.e,drawn[f.e]); break; }
+                f.r=visit(f.e);
+                if (inner) { if (n.kind==NodeKind::Binary) drawn[f.e]=f.r; work.push_back({n.lhs,0,-1,-1,f.depth+1}); continue; }
+                break;
+            case 1:
+                f.l=ret;
+                if (n.kind==NodeKind::Binary) { work.push_back({n.rhs,0,-1,-1,f.depth+1}); continue; }
+                edge(f.r,f.l,"expr");
+                break;
+            default:
+                edge(f.r,f.l,"left"); edge(f.r,ret,"right");
+                break;
+            }
+            ret=f.r; work.pop_back();
+        }
+        return ret;
+    }
+
+    // The Program box and the statements in --stmt-range, until the cap
+    void program(){
+        int root=node("Program");
+        size_t i=0, end=min(opt.last, ast.program.size());
+        for (NodeId s: ast.program) {
+            if (++i<opt.first) continue;
+            if (i>end) break;
+            if (capped()) {
+                int r=open(); put("… "); putInt((long long)(end-i+1)); put(" more statements"); close(true);
+                edge(root, r); break;
+            }
+            edge(root, emit(s), "stmt"+to_string(i));
+        }
     }
 };
 
-static string trim(const string& s){
-    auto l=s.find_first_not_of(" \t\r\n"), r=s.find_last_not_of(" \t\r\n");
-    if (l==string::npos) return ""; return s.substr(l,r-l+1);
+// ===== Binary image =====
+// annotated_ast.bin: the arena, its annotations, the statement list, the
+// symbol table, the atom table and the diagnostics as flat arrays at 8-byte
+// aligned offsets, so a reader maps the file and uses it in place. Cache
+// entries add the token array. The arrays keep their in-memory layout; the
+// header records byte order and struct sizes, and kImageVersion is bumped
+// whenever any layout changes.
+constexpr char kImageMagic[8] = {'C','3','A','S','T','I','M','G'};
+constexpr uint32_t kImageVersion = 4;
+constexpr uint32_t kByteOrder = 0x01020304;
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t version, byteOrder;
+    uint32_t nodeSize, annSize, tokSize, diagSize;  // sizeof(Node/Annotation/Token/Diagnostic) when written
+    uint64_t nodes, stmts, atoms, atomBytes, tokens, warnings, errors;
+    uint64_t nodeOff, annOff, stmtOff, symOff, atomOff, charOff, tokOff, diagOff;  // atomOff: count+1 offsets into the chars
+    uint64_t fileSize;                              // bytes, every section included
+};
+
+// Records are copied field by field into zeroed memory before writing, so
+// padding never reaches the file and the same input gives the same image.
+static void copyFields(Node& c, const Node& n){ c.kind=n.kind; c.op=n.op; c.line=n.line; c.lhs=n.lhs; c.rhs=n.rhs; c.value=n.value; }
+static void copyFields(Annotation& c, const Annotation& a){
+    c.constVal=a.constVal; c.resolvedDecl=a.resolvedDecl; c.type=a.type; c.isConst=a.isConst;
+    c.analyzed=a.analyzed; c.diag=a.diag; c.tainted=a.tainted;
 }
+static void copyFields(Token& c, const Token& t){ c.type=t.type; c.off=t.off; c.len=t.len; c.line=t.line; }
+static void copyFields(Diagnostic& c, const Diagnostic& d){ c.code=d.code; c.line=d.line; c.arg=d.arg; }
 
-int main(){
-    ifstream fin("input.txt");
-    if (!fin){ cerr<<"Error: could not open input.txt\n"; return 1; }
+static bool writeImage(const string& path, const AST& ast, const Semantic& S,
+                       const vector<Diagnostic>& warnings={}, const vector<Token>& tokens={}){
+    ImageHeader h;
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, kImageMagic, sizeof h.magic);
+    h.version=kImageVersion; h.byteOrder=kByteOrder;
+    h.nodeSize=sizeof(Node); h.annSize=sizeof(Annotation); h.tokSize=sizeof(Token); h.diagSize=sizeof(Diagnostic);
+    h.nodes=ast.nodes.size(); h.stmts=ast.program.size(); h.atoms=atoms.size(); h.tokens=tokens.size();
+    h.warnings=warnings.size(); h.errors=S.errors.size();
+    vector<uint64_t> atomAt(atoms.size()+1, 0);
+    for (Atom a=0; a<atoms.size(); ++a) atomAt[a+1]=atomAt[a]+atoms.str(a).size();
+    h.atomBytes=atomAt.back();
 
-    vector<unique_ptr<Stmt>> program;
-    vector<string> warnings;
-    string line; int lineNo=1;
+    uint64_t at=sizeof h;
+    auto place=[&](uint64_t bytes){ at=(at+7)&~uint64_t(7); uint64_t o=at; at+=bytes; return o; };
+    h.nodeOff=place(h.nodes*sizeof(Node));
+    h.annOff=place(h.nodes*sizeof(Annotation));
+    h.stmtOff=place(h.stmts*sizeof(NodeId));
+    h.symOff=place(S.sym.size()*sizeof(NodeId));
+    h.atomOff=place(atomAt.size()*sizeof(uint64_t));
+    h.charOff=place(h.atomBytes);
+    h.tokOff=place(h.tokens*sizeof(Token));
+    h.diagOff=place((h.warnings+h.errors)*sizeof(Diagnostic));
+    h.fileSize=at;
 
-    cout<<"=== Lexical Tokens ===\n";
-    while (getline(fin,line)) {
-        string t = trim(line);
-        if (t.empty()) { ++lineNo; continue; }
-        auto L = Lexer::lexLine(t, lineNo);
-        warnings.insert(warnings.end(), L.warnings.begin(), L.warnings.end());
-        for (auto &tk : L.tokens) if (tk.type!=TokType::END) cout<<"Line "<<tk.line<<" -> "<<tk.lexeme<<"\n";
-        Parser P(L.tokens); string err;
-        auto stmt = P.parseStatement(err);
-        if (!stmt){ cerr<<"Syntax error: "<<err<<"\n"; return 2; }
-        program.push_back(std::move(stmt));
-        ++lineNo;
-    }
-
-    // Semantic analysis
-    Semantic sem; sem.analyze(program);
+    ofstream out(path, ios::binary);
+    if (!out) return false;
+    uint64_t pos=0;
+    auto section=[&](uint64_t off, const void* p, size_t n){
+        static const char zero[8]={};
+        out.write(zero, streamsize(off-pos));
+        out.write(static_cast<const char*>(p), streamsize(n)); pos=off+n;
+    };
+    vector<char> block;
+    auto records=[&](uint64_t off, const auto& v){
+        using T=typename decay_t<decltype(v)>::value_type;
+        constexpr size_t kBlock=4096;
+        block.resize(kBlock*sizeof(T));
+        section(off, nullptr, 0);
+        for (size_t i=0; i<v.size(); i+=kBlock) {
+            size_t m=min(kBlock, v.size()-i);
+            memset(block.data(), 0, m*sizeof(T));
+            for (size_t j=0; j<m; ++j) copyFields(*reinterpret_cast<T*>(block.data()+j*sizeof(T)), v[i+j]);
+            section(pos, block.data(), m*sizeof(T));
+        }
+    };
+    section(0, &h, sizeof h);
+    records(h.nodeOff, ast.nodes);
+    records(h.annOff, S.ann);
+    section(h.stmtOff, ast.program.data(), ast.program.size()*sizeof(NodeId));
+    section(h.symOff, S.sym.data(), S.sym.size()*sizeof(NodeId));
+    section(h.atomOff, atomAt.data(), atomAt.size()*sizeof(uint64_t));
+    for (Atom a=0; a<atoms.size(); ++a) { const string& t=atoms.str(a); section(pos, t.data(), t.size()); }
+    records(h.tokOff, tokens);
+    records(h.diagOff, warnings);
+    records(pos, S.errors);
+    return bool(out.flush());
+}
 
-    // Report
-    if (!warnings.empty()) {
-        cout << "\n=== Warnings ===\n";
-        for (auto& w : warnings) cout << w << "\n";
+// Read-only view of an annotated_ast.bin. Opening maps the file and checks
+// the header and section bounds only, so it costs the same for any size.
+struct ASTImage {
+    const Node* nodes=nullptr;
+    const Annotation* ann=nullptr;
+    const NodeId* program=nullptr;
+    const NodeId* sym=nullptr;          // Atom -> first Decl
+    const Token* tokens=nullptr;        // cache entries only; offsets into the source
+    const Diagnostic* warnings=nullptr; // then the errors; atom arguments index atom()
+    size_t nodeCount=0, stmtCount=0, atomCount=0, tokenCount=0, warningCount=0, errorCount=0;
+
+    bool open(const string& path, string& err){
+        if (!file.open(path)) { err="could not open "+path; return false; }
+        string_view d=file.view();
+        if (d.size()<sizeof(ImageHeader)) { err="not an AST image"; return false; }
+        const ImageHeader* h=reinterpret_cast<const ImageHeader*>(d.data());
+        if (memcmp(h->magic, kImageMagic, sizeof h->magic)!=0) { err="not an AST image"; return false; }
+        if (h->version!=kImageVersion) { err="image version "+to_string(h->version)+", expected "+to_string(kImageVersion); return false; }
+        if (h->byteOrder!=kByteOrder || h->nodeSize!=sizeof(Node) || h->annSize!=sizeof(Annotation) || h->tokSize!=sizeof(Token)
+            || h->diagSize!=sizeof(Diagnostic)) {
+            err="image written for a different layout"; return false;
+        }
+        auto fits=[&](uint64_t off, uint64_t n, uint64_t size){ return off%8==0 && off<=h->fileSize && n<=(h->fileSize-off)/size; };
+        if (h->fileSize>d.size() || !fits(h->nodeOff,h->nodes,sizeof(Node)) || !fits(h->annOff,h->nodes,sizeof(Annotation))
+            || !fits(h->stmtOff,h->stmts,sizeof(NodeId)) || !fits(h->symOff,h->atoms,sizeof(NodeId))
+            || !fits(h->atomOff,h->atoms+1,sizeof(uint64_t)) || !fits(h->charOff,h->atomBytes,1)
+            || !fits(h->tokOff,h->tokens,sizeof(Token)) || h->warnings>h->fileSize || h->errors>h->fileSize
+            || !fits(h->diagOff,h->warnings+h->errors,sizeof(Diagnostic))) { err="truncated AST image"; return false; }
+        nodes=reinterpret_cast<const Node*>(d.data()+h->nodeOff);
+        ann=reinterpret_cast<const Annotation*>(d.data()+h->annOff);
+        program=reinterpret_cast<const NodeId*>(d.data()+h->stmtOff);
+        sym=reinterpret_cast<const NodeId*>(d.data()+h->symOff);
+        tokens=reinterpret_cast<const Token*>(d.data()+h->tokOff);
+        atomAt=reinterpret_cast<const uint64_t*>(d.data()+h->atomOff); chars=d.data()+h->charOff;
+        warnings=reinterpret_cast<const Diagnostic*>(d.data()+h->diagOff);
+        nodeCount=h->nodes; stmtCount=h->stmts; atomCount=h->atoms; tokenCount=h->tokens;
+        warningCount=h->warnings; errorCount=h->errors;
+        if (atomAt[atomCount]>h->atomBytes) { err="corrupt AST image"; return false; }
+        return true;
+    }
+    string_view atom(Atom a) const { return string_view(chars+atomAt[a], atomAt[a+1]-atomAt[a]); }
+    const Diagnostic* errors() const { return warnings+warningCount; }
+
+    // Every id, atom offset and diagnostic argument in range, and children
+    // before parents as the arena guarantees. O(n), so only for readers that
+    // touch everything anyway; open() alone checks no more than the sections.
+    bool verify(string& err) const {
+        auto bad=[&](const char* what){ err=string("corrupt AST image: ")+what; return false; };
+        if (atomAt[0]!=0) return bad("atom table");
+        for (size_t a=0; a<atomCount; ++a) if (atomAt[a+1]<atomAt[a]) return bad("atom table");
+        unordered_set<string_view> seen(atomCount);
+        for (Atom a=0; a<atomCount; ++a) if (!seen.insert(atom(a)).second) return bad("duplicate atom");
+        auto id=[&](NodeId n, size_t below){ return n<below; };
+        for (NodeId e=0; e<nodeCount; ++e) {
+            const Node& n=nodes[e];
+            if (n.kind>NodeKind::Print || n.op>BinOp::Div) return bad("node tag");
+            switch (n.kind) {
+            case NodeKind::Number: break;
+            case NodeKind::Ident: case NodeKind::Decl: if (n.name>=atomCount) return bad("node atom"); break;
+            case NodeKind::Binary: if (!id(n.lhs,e) || !id(n.rhs,e)) return bad("node child"); break;
+            case NodeKind::Print:  if (!id(n.lhs,e)) return bad("node child"); break;
+            }
+            NodeId d=ann[e].resolvedDecl;
+            if (d!=NoNode && (n.kind!=NodeKind::Ident || !id(d,nodeCount) || nodes[d].kind!=NodeKind::Decl)) return bad("annotation");
+            if (n.kind==NodeKind::Ident && ann[e].analyzed && d==NoNode && ann[e].diag!=Diag::Undeclared) return bad("annotation");
+            if (ann[e].diag>Diag::NotInt || (ann[e].diag==Diag::Undeclared && n.kind!=NodeKind::Ident)) return bad("annotation");
+        }
+        for (size_t i=0; i<stmtCount; ++i) {
+            NodeId st=program[i];
+            if (!id(st,nodeCount) || (nodes[st].kind!=NodeKind::Decl && nodes[st].kind!=NodeKind::Print)) return bad("statement");
+        }
+        for (size_t a=0; a<atomCount; ++a)
+            if (sym[a]!=NoNode && (!id(sym[a],nodeCount) || nodes[sym[a]].kind!=NodeKind::Decl)) return bad("symbol table");
+        for (size_t i=0; i<warningCount+errorCount; ++i) {
+            const Diagnostic& d=warnings[i];
+            switch (d.code) {
+            case Diag::Keyword:     if (d.arg>=kNumKeywords || !kKeywords[d.arg].warning) return bad("diagnostic"); break;
+            case Diag::UnknownChar: if (d.arg>255) return bad("diagnostic"); break;
+            case Diag::Redeclaration: case Diag::Undeclared: if (d.arg>=atomCount) return bad("diagnostic"); break;
+            case Diag::DivByZero: case Diag::NotInt: case Diag::OutOfRange: break;
+            default: return bad("diagnostic");
+            }
+        }
+        return true;
+    }
+private:
+    SourceFile file;
+    const uint64_t *atomAt=nullptr;
+    const char *chars=nullptr;
+};
+
+// --inspect-bin FILE: open an image and summarize it
+static int inspectImage(const string& path){
+    auto t0=chrono::steady_clock::now();
+    ASTImage img; string err;
+    if (!img.open(path, err)) { cerr << "Error: " << err << "\n"; return 1; }
+    auto t1=chrono::steady_clock::now();
+    if (!img.verify(err)) { cerr << "Error: " << err << "\n"; return 1; }
+    size_t decls=0, folded=0;
+    for (size_t i=0; i<img.stmtCount; ++i) {
+        NodeId s=img.program[i];
+        if (img.nodes[s].kind==NodeKind::Decl) ++decls; else if (img.ann[s].isConst) ++folded;
+    }
+    cout << path << ": " << img.nodeCount << " nodes, " << img.stmtCount << " statements ("
+         << decls << " decls, " << folded << " folded prints), " << img.atomCount << " atoms, "
+         << img.warningCount << " warnings, " << img.errorCount << " errors\n"
+         << "opened in " << chrono::duration<double,milli>(t1-t0).count() << " ms\n";
+    return 0;
+}
+
+// ===== Cache =====
+// Front-end results keyed by a hash of input.txt and the tool build, in
+// .build-cache/class3-<key>.bin (an image with tokens). Entries are written
+// to a temp file and renamed into place, so concurrent runs never see a
+// partial one; a reader keeps its mapping even if the entry is evicted.
+// Hits refresh the entry's mtime and the oldest go first past the limit.
+static const char* kCacheDir = ".build-cache";
+static const char* kToolVersion = "class3 " __DATE__ " " __TIME__;
+
+// FNV-1a of the input together with the build and image version, so a
+// rebuilt class3 never reads an entry an older one wrote
+static string cacheKey(string_view src){
+    uint64_t h=1469598103934665603ULL;
+    auto mix=[&](string_view s){ for (unsigned char c: s) { h^=c; h*=1099511628211ULL; } h^=0xff; h*=1099511628211ULL; };
+    mix(src); mix(kToolVersion); mix(to_string(kImageVersion));
+    char t[17]; snprintf(t, sizeof t, "%016llx", (unsigned long long)h);
+    return t;
+}
+static string cachePath(const string& key){ return string(kCacheDir)+"/class3-"+key+".bin"; }
+
+// Fills a fresh AST/Semantic (and the global atoms) from an entry made for
+// a source of `srcSize` bytes; a damaged entry is a miss
+static bool cacheLoad(const string& key, size_t srcSize, AST& ast, Semantic& S, vector<Diagnostic>& warnings, vector<Token>& tokens){
+    ASTImage img; string err;
+    if (!img.open(cachePath(key), err) || atoms.size()!=0 || !img.verify(err)) return false;
+    for (size_t i=0; i<img.tokenCount; ++i) {
+        const Token& t=img.tokens[i];
+        if (t.type>TokType::END || t.off>srcSize || t.len>srcSize-t.off) return false;
+    }
+    for (Atom a=0; a<img.atomCount; ++a) atoms.intern(img.atom(a));
+    ast.nodes.assign(img.nodes, img.nodes+img.nodeCount);
+    ast.program.assign(img.program, img.program+img.stmtCount);
+    S.ann.assign(img.ann, img.ann+img.nodeCount);
+    S.sym.assign(img.sym, img.sym+img.atomCount);
+    tokens.assign(img.tokens, img.tokens+img.tokenCount);
+    warnings.assign(img.warnings, img.warnings+img.warningCount);
+    S.errors.assign(img.errors(), img.errors()+img.errorCount);
+    error_code ec;
+    filesystem::last_write_time(cachePath(key), filesystem::file_time_type::clock::now(), ec);
+    return true;
+}
+
+static void cacheStore(const string& key, const AST& ast, const Semantic& S, const vector<Diagnostic>& warnings,
+                       const vector<Token>& tokens, uint64_t limit){
+    error_code ec;
+    filesystem::create_directories(kCacheDir, ec);
+    static atomic<unsigned> seq{0};
+    string tmp=cachePath(key)+".tmp"+to_string(random_device{}())+"-"+to_string(seq++);
+    if (!writeImage(tmp, ast, S, warnings, tokens)) { filesystem::remove(tmp, ec); return; }
+    filesystem::rename(tmp, cachePath(key), ec);
+    if (ec) { filesystem::remove(tmp, ec); return; }
+
+    // Evict least recently used entries beyond the limit, never the one just
+    // written. Temp files count while a writer may still be busy with them;
+    // one untouched for a while was left by a writer that died, and goes.
+    vector<tuple<filesystem::file_time_type, uintmax_t, filesystem::path>> entries;
+    uintmax_t total=0;
+    auto stale=filesystem::file_time_type::clock::now()-chrono::minutes(10);
+    for (auto& e: filesystem::directory_iterator(kCacheDir, ec)) {
+        string name=e.path().filename().string();
+        bool temp=name.find(".bin.tmp")!=string::npos;
+        if (name.rfind("class3-",0)!=0 || (!temp && e.path().extension()!=".bin")) continue;
+        error_code fe; uintmax_t sz=e.file_size(fe); auto t=e.last_write_time(fe);
+        if (fe) continue;
+        if (temp && t<stale) { filesystem::remove(e.path(), fe); continue; }
+        total+=sz;
+        if (!temp && e.path()!=filesystem::path(cachePath(key))) entries.emplace_back(t, sz, e.path());
+    }
+    sort(entries.begin(), entries.end());
+    for (auto& [t, sz, p]: entries) {
+        if (total<=limit) break;
+        if (filesystem::remove(p, ec)) total-=sz;
+    }
+}
+
+// ===== IR =====
+// SSA three-address code for one straight-line block. A value is the index
+// of the instruction defining it; there are no assignments, so no phis.
+// Pure instructions come first in arena (topological) order, then the
+// prints in program order.
+enum class Opc : uint8_t { Const, Add, Sub, Mul, Div, Shl, Print };
+using Value = uint32_t;
+constexpr Value NoValue = UINT32_MAX;
+
+struct Inst {
+    Opc op; Value a, b; long long imm;   // Const: imm, Shl: a << imm, Print: a
+};
+
+static const char* opcStr(Opc o){ static const char* s[]={"const","add","sub","mul","div","shl","print"}; return s[(int)o]; }
+static bool commutes(Opc o){ return o==Opc::Add || o==Opc::Mul; }
+
+struct IR {
+    vector<Inst> code;
+    Value emit(Opc op, Value a=NoValue, Value b=NoValue, long long imm=0){ code.push_back({op,a,b,imm}); return Value(code.size()-1); }
+
+    // Only called on programs without semantic errors. Lowers what the
+    // statements reach, each expression in post-order: the order a parse
+    // creates the nodes, so an arena with leftovers (--watch) lowers the
+    // same as a fresh one.
+    static IR lower(const AST& ast, const Semantic& S){
+        IR ir; vector<Value> val(ast.nodes.size(), NoValue);
+        for (NodeId s: ast.program) if (ast[s].kind==NodeKind::Decl) val[s]=ir.emit(Opc::Const, NoValue, NoValue, ast[s].value);
+        vector<pair<NodeId,bool>> todo;   // (node, children done)
+        for (NodeId s: ast.program) if (ast[s].kind==NodeKind::Print) {
+            todo.push_back({ast[s].lhs,false});
+            while (!todo.empty()) {
+                auto [e,done] = todo.back(); todo.pop_back();
+                if (val[e]!=NoValue) continue;
+                const Node& n=ast[e];
+                if (!done && n.kind==NodeKind::Binary) { todo.push_back({e,true}); todo.push_back({n.rhs,false}); todo.push_back({n.lhs,false}); continue; }
+                switch (n.kind) {
+                case NodeKind::Number: val[e]=ir.emit(Opc::Const, NoValue, NoValue, n.value); break;
+                case NodeKind::Ident:  val[e]=val[S.get(e).resolvedDecl]; break;
+                case NodeKind::Binary: val[e]=ir.emit(Opc(int(Opc::Add)+int(n.op)), val[n.lhs], val[n.rhs]); break;
+                default: break;
+                }
+            }
+        }
+        for (NodeId s: ast.program) if (ast[s].kind==NodeKind::Print) ir.emit(Opc::Print, val[ast[s].lhs]);
+        return ir;
+    }
+
+    void dump(ostream& os) const {
+        for (Value v=0; v<code.size(); ++v) {
+            const Inst& i=code[v];
+            os << "  ";
+            switch (i.op) {
+            case Opc::Const: os << "%" << v << " = const " << i.imm; break;
+            case Opc::Shl:   os << "%" << v << " = shl %" << i.a << ", " << i.imm; break;
+            case Opc::Print: os << "print %" << i.a; break;
+            default:         os << "%" << v << " = " << opcStr(i.op) << " %" << i.a << ", %" << i.b; break;
+            }
+            os << "\n";
+        }
+    }
+};
+
+// ===== Passes =====
+// Each pass is one forward (DCE: one backward) sweep and returns how many
+// instructions it changed. Passes that replace a value record it in `to`
+// and rewrite later operands as they go, leaving the dead def for DCE.
+struct Forward {
+    vector<Value> to;
+    explicit Forward(size_t n) : to(n) { iota(to.begin(), to.end(), Value(0)); }
+    void operands(Inst& i) const { if (i.a!=NoValue) i.a=to[i.a]; if (i.b!=NoValue) i.b=to[i.b]; }
+};
+
+static size_t constProp(IR& ir){
+    size_t changed=0;
+    for (Inst& i: ir.code) {
+        if (i.op==Opc::Const || i.op==Opc::Print) continue;
+        const Inst& A=ir.code[i.a];
+        if (A.op!=Opc::Const || (i.op!=Opc::Shl && ir.code[i.b].op!=Opc::Const)) continue;
+        long long x=A.imm, y= i.op==Opc::Shl? i.imm : ir.code[i.b].imm, r=0;
+        switch (i.op) {
+        case Opc::Add: r=x+y; break;
+        case Opc::Sub: r=x-y; break;
+        case Opc::Mul: r=x*y; break;
+        case Opc::Div: if (!y) continue; r=x/y; break;
+        case Opc::Shl: r=x*(1LL<<y); break;
+        default: continue;
+        }
+        i = Inst{Opc::Const, NoValue, NoValue, r}; ++changed;
+    }
+    return changed;
+}
+
+static size_t gvn(IR& ir){
+    struct Key { Opc op; Value a,b; long long imm; bool operator==(const Key& k) const { return op==k.op&&a==k.a&&b==k.b&&imm==k.imm; } };
+    struct Hash { size_t operator()(const Key& k) const { return hash<long long>()(k.imm ^ (uint64_t(k.a)<<32 | k.b) * 0x9E3779B97F4A7C15ull ^ int(k.op)); } };
+    unordered_map<Key,Value,Hash> seen; seen.reserve(ir.code.size());
+    Forward F(ir.code.size()); size_t changed=0;
+    for (Value v=0; v<ir.code.size(); ++v) {
+        Inst& i=ir.code[v]; F.operands(i);
+        if (i.op==Opc::Print) continue;
+        Key k{i.op,i.a,i.b,i.imm};
+        if (commutes(k.op) && k.a>k.b) swap(k.a,k.b);
+        auto r=seen.emplace(k,v);
+        if (!r.second){ F.to[v]=r.first->second; ++changed; }
+    }
+    return changed;
+}
+
+// x*2^k -> x<<k, x*1 / x+0 / x-0 / x/1 -> x, x*0 -> 0. Signed division by a
+// power of two is not a plain shift, so it is left alone.
+static size_t strengthReduce(IR& ir){
+    Forward F(ir.code.size()); size_t changed=0;
+    auto isConst=[&](Value v, long long c){ return v!=NoValue && ir.code[v].op==Opc::Const && ir.code[v].imm==c; };
+    auto pow2=[&](Value v){ if (v==NoValue || ir.code[v].op!=Opc::Const) return -1; long long c=ir.code[v].imm;
+                            return c>1 && !(c&(c-1))? __builtin_ctzll(c) : -1; };
+    for (Value v=0; v<ir.code.size(); ++v) {
+        Inst& i=ir.code[v]; F.operands(i);
+        switch (i.op) {
+        case Opc::Add:
+            if (isConst(i.b,0)) F.to[v]=i.a; else if (isConst(i.a,0)) F.to[v]=i.b; else continue;
+            break;
+        case Opc::Sub: case Opc::Div:
+            if (isConst(i.b, i.op==Opc::Sub? 0 : 1)) F.to[v]=i.a; else continue;
+            break;
+        case Opc::Mul:
+            if (isConst(i.b,1)) F.to[v]=i.a; else if (isConst(i.a,1)) F.to[v]=i.b;
+            else if (isConst(i.a,0) || isConst(i.b,0)) i=Inst{Opc::Const,NoValue,NoValue,0};
+            else if (int k=pow2(i.b); k>=0) i=Inst{Opc::Shl,i.a,NoValue,k};
+            else if (int k=pow2(i.a); k>=0) i=Inst{Opc::Shl,i.b,NoValue,k};
+            else continue;
+            break;
+        default: continue;
+        }
+        ++changed;
+    }
+    return changed;
+}
+
+// Keeps prints and whatever they use, then renumbers
+static size_t dce(IR& ir){
+    vector<char> live(ir.code.size(), 0);
+    for (size_t v=ir.code.size(); v-- > 0; ) {
+        const Inst& i=ir.code[v];
+        if (i.op==Opc::Print) live[v]=1;
+        if (!live[v]) continue;
+        if (i.a!=NoValue) live[i.a]=1;
+        if (i.b!=NoValue) live[i.b]=1;
+    }
+    vector<Value> to(ir.code.size(), NoValue); size_t n=0;
+    for (size_t v=0; v<ir.code.size(); ++v) if (live[v]) {
+        Inst i=ir.code[v];
+        if (i.a!=NoValue) i.a=to[i.a];
+        if (i.b!=NoValue) i.b=to[i.b];
+        to[v]=Value(n); ir.code[n++]=i;
+    }
+    size_t removed=ir.code.size()-n; ir.code.resize(n);
+    return removed;
+}
+
+struct PassManager {
+    struct Pass { const char* name; size_t (*run)(IR&); };
+    struct Stat { const char* name; double ms; size_t changed, after; };
+    vector<Pass> passes{ {"constprop",constProp}, {"gvn",gvn}, {"strength",strengthReduce}, {"dce",dce} };
+    vector<Stat> stats;
+
+    void run(IR& ir){
+        for (auto& p: passes) {
+            auto t0=chrono::steady_clock::now();
+            size_t c=p.run(ir);
+            auto t1=chrono::steady_clock::now();
+            stats.push_back({p.name, chrono::duration<double,milli>(t1-t0).count(), c, ir.code.size()});
+        }
     }
-    if (!sem.errors.empty()) {
-        cout << "\n=== Semantic Errors ===\n";
-        for (auto& e : sem.errors) cout << e << "\n";
-        // continue to print what we have
+    void report(ostream& os) const {
+        for (auto& s: stats)
+            os << "  " << left << setw(10) << s.name << right << fixed << setprecision(3) << setw(10) << s.ms << " ms"
+               << setw(10) << s.changed << " changed" << setw(10) << s.after << " insts\n";
+        os.unsetf(ios::floatfield);
     }
+};
+
+// ===== Evaluator =====
+// Each expression node is compiled once into a closure: a function pointer
+// picked for (operator, left kind, right kind) plus its bound operands, so
+// running a statement is a chain of direct calls with no tag switches and
+// no name lookups. Constant and identifier operands are read in place.
+struct Closure;
+using EvalFn = long long (*)(const Closure&, const long long* env);
+struct Closure {
+    EvalFn fn; long long k; Atom slot;   // k: Number value, slot: Ident variable
+    const Closure *l, *r;
+};
+
+enum class Arg : uint8_t { Const, Ident, Any };
+template<Arg K> static inline long long arg(const Closure& c, const long long* env){
+    if constexpr (K==Arg::Const) return c.k;
+    else if constexpr (K==Arg::Ident) return env[c.slot];
+    else return c.fn(c, env);
+}
+static inline long long applyOp(BinOp o, long long x, long long y){
+    switch (o) {
+    case BinOp::Add: return x+y;
+    case BinOp::Sub: return x-y;
+    case BinOp::Mul: return x*y;
+    case BinOp::Div: return x/y;   // divisors of 0 are rejected by Semantic
+    }
+    return 0;
+}
+template<BinOp O, Arg L, Arg R> static long long binFn(const Closure& c, const long long* env){
+    return applyOp(O, arg<L>(*c.l,env), arg<R>(*c.r,env));
+}
+static long long constFn(const Closure& c, const long long*){ return c.k; }
+static long long identFn(const Closure& c, const long long* env){ return env[c.slot]; }
+
+template<size_t I> constexpr EvalFn binAt(){ return &binFn<BinOp(I/9), Arg(I/3%3), Arg(I%3)>; }
+template<size_t... I> constexpr array<EvalFn,36> binTable(index_sequence<I...>){ return {binAt<I>()...}; }
+static constexpr array<EvalFn,36> kBinFns = binTable(make_index_sequence<36>{});
 
-    cout << "\n";
-    ASTPrinter::print(program, sem);
+// Runs programs without semantic errors. Declarations are hoisted, as
+// Semantic binds names program-wide, and are re-stored when executed.
+// Closures recurse once per level, so expressions taller than kDeep are
+// walked with an explicit stack down to their shallow subtrees.
+struct Evaluator {
+    static constexpr uint32_t kDeep = 4096;
+    const AST& ast;
+    vector<Closure> code;       // indexed by NodeId, shared like the DAG
+    vector<uint32_t> height;    // levels of Binary below each node
+    vector<long long> env;      // indexed by Atom
+
+    Evaluator(const AST& a, const Semantic& S) : ast(a), code(a.nodes.size()), height(a.nodes.size(), 0), env(atoms.size(), 0) {
+        for (NodeId s: ast.program) if (ast[s].kind==NodeKind::Decl && S.sym[ast[s].name]==s) env[ast[s].name]=ast[s].value;
+        auto kind=[&](NodeId e){ NodeKind k=ast[e].kind; return k==NodeKind::Number? Arg::Const : k==NodeKind::Ident? Arg::Ident : Arg::Any; };
+        for (NodeId e=0; e<ast.nodes.size(); ++e) {
+            const Node& n=ast[e]; Closure& c=code[e];
+            switch (n.kind) {
+            case NodeKind::Number: c.fn=constFn; c.k=n.value; break;
+            case NodeKind::Ident:  c.fn=identFn; c.slot=n.name; break;
+            case NodeKind::Binary:
+                c.fn=kBinFns[int(n.op)*9 + int(kind(n.lhs))*3 + int(kind(n.rhs))];
+                c.l=&code[n.lhs]; c.r=&code[n.rhs];
+                height[e]=max(height[n.lhs],height[n.rhs])+1; break;
+            default: break;
+            }
+        }
+    }
+
+    long long eval(NodeId root) const {
+        if (height[root]<=kDeep) { const Closure& c=code[root]; return c.fn(c, env.data()); }
+        vector<pair<NodeId,bool>> todo{{root,false}};   // (node, children done)
+        vector<long long> vals;
+        while (!todo.empty()) {
+            auto [e,done] = todo.back(); todo.pop_back();
+            if (height[e]<=kDeep) { const Closure& c=code[e]; vals.push_back(c.fn(c, env.data())); continue; }
+            const Node& n=ast[e];   // only Binary nodes are tall
+            if (!done) { todo.push_back({e,true}); todo.push_back({n.rhs,false}); todo.push_back({n.lhs,false}); continue; }
+            long long y=vals.back(); vals.pop_back();
+            vals.back()=applyOp(n.op, vals.back(), y);
+        }
+        return vals.back();
+    }
+
+    template<class Out> void run(Out out){
+        for (NodeId s: ast.program) {
+            const Node& n=ast[s];
+            if (n.kind==NodeKind::Decl) env[n.name]=n.value;
+            else out(s, eval(n.lhs));
+        }
+    }
+};
+
+// ===== Benchmark =====
+// N statements `dekhao((x+1)*(x-2)/3+x)` after `integer x te 7`
+static void benchProgram(AST& ast, int n){
+    Atom x = atoms.intern("x");
+    ast.program.push_back(ast.decl(x,7,1));
+    for (int i=0;i<n;++i) {
+        int ln=i+2;
+        NodeId a=ast.binary(BinOp::Add, ast.ident(x,ln), ast.number(1,ln), ln);
+        NodeId b=ast.binary(BinOp::Sub, ast.ident(x,ln), ast.number(2,ln), ln);
+        NodeId c=ast.binary(BinOp::Div, ast.binary(BinOp::Mul,a,b,ln), ast.number(3,ln), ln);
+        ast.program.push_back(ast.print(ast.binary(BinOp::Add,c,ast.ident(x,ln),ln), ln));
+    }
+}
+
+// --bench-analyze N: analysis only
+static int benchAnalyze(int n, int jobs){
+    AST ast; benchProgram(ast, n);
+    auto t0=chrono::steady_clock::now();
+    Semantic sem(ast); sem.analyze(jobs);
+    auto t1=chrono::steady_clock::now();
+    cout << "analyze: " << ast.nodes.size() << " nodes in "
+         << chrono::duration<double,milli>(t1-t0).count() << " ms\n";
+    return sem.errors.empty()? 0 : 1;
+}
+
+// The baseline for --bench-eval: a recursive walk switching on every node.
+// Deliberately naive, and only ever run on the shallow benchmark program.
+struct TreeEval : ASTVisitor<TreeEval, long long> {
+    const AST& ast; const vector<long long>& env;
+    TreeEval(const AST& a, const vector<long long>& e) : ast(a), env(e) {}
+    long long visitNumber(NodeId, const Node& n){ return n.value; }
+    long long visitIdent(NodeId, const Node& n){ return env[n.name]; }
+    long long visitBinary(NodeId, const Node& n){
+        long long x=visit(n.lhs), y=visit(n.rhs);
+        return applyOp(n.op, x, y);
+    }
+    long long visitDecl(NodeId, const Node&){ return 0; }
+    long long visitPrint(NodeId, const Node& n){ return visit(n.lhs); }
+};
+
+// --bench-eval N: run every statement with the closures and with TreeEval
+static int benchEval(int n){
+    AST ast; benchProgram(ast, n);
+    Semantic sem(ast); sem.analyze();
+    if (!sem.errors.empty()) return 1;
+    auto t0=chrono::steady_clock::now();
+    Evaluator E(ast, sem);
+    auto t1=chrono::steady_clock::now();
+    long long a=0; E.run([&](NodeId, long long v){ a+=v; });
+    auto t2=chrono::steady_clock::now();
+    TreeEval T(ast, E.env); long long b=0;
+    for (NodeId s: ast.program) if (ast[s].kind==NodeKind::Print) b+=T.visit(s);
+    auto t3=chrono::steady_clock::now();
+    auto ms=[](auto d){ return chrono::duration<double,milli>(d).count(); };
+    cout << "compile: " << ms(t1-t0) << " ms\nclosures: " << ms(t2-t1) << " ms\ntree walk: " << ms(t3-t2) << " ms\n";
+    return a==b? 0 : 1;
+}
+
+// --bench-incremental N: N prints over 100 names, then one declaration edited.
+// The edit should cost about the uses of that name, not the whole program.
+static int benchIncremental(int n){
+    auto text=[&](int v){
+        string t;
+        for (int k=0;k<100;++k) t+="integer x"+to_string(k)+" te "+to_string(k==7? v : k+1)+"\n";
+        for (int i=0;i<n;++i) t+="dekhao((x"+to_string(i%100)+"+"+to_string(i)+")*x"+to_string(i*7%100)+")\n";
+        return t;
+    };
+    string a=text(8), b=text(9);
+    Session S;
+    auto t0=chrono::steady_clock::now();
+    S.update(a);
+    auto t1=chrono::steady_clock::now();
+    Session::Stats st=S.update(b);
+    auto t2=chrono::steady_clock::now();
+    auto ms=[](auto d){ return chrono::duration<double,milli>(d).count(); };
+    cout << "initial: " << ms(t1-t0) << " ms for " << st.lines << " lines\nedit: " << ms(t2-t1) << " ms, reparsed "
+         << st.reparsed << " lines, reanalyzed " << st.reanalyzed << " nodes\n";
+    // same folded values as a from-scratch analysis
+    Session F; F.update(b);
+    for (size_t i=0; i<S.ast.program.size(); ++i)
+        if (S.sem.get(S.ast.program[i]).constVal!=F.sem.get(F.ast.program[i]).constVal) return 1;
+    return 0;
+}
+
+// Renders the first `cap` diagnostics of a section and counts the rest
+static void printDiags(const char* title, const vector<Diagnostic>& ds, size_t cap){
+    if (ds.empty()) return;
+    cout << "\n=== " << title << " ===\n";
+    for (size_t i=0; i<min(cap, ds.size()); ++i) cout << render(ds[i]) << "\n";
+    if (ds.size()>cap) cout << "... " << ds.size()-cap << " more\n";
+}
+
+// Everything after the front end: diagnostics, tree, DOT, image, IR, run
+static void emitResults(const AST& ast, const Semantic& sem, const vector<Diagnostic>& warnings, const DotOptions& dotOpt,
+                        bool showTree, bool showIR, size_t maxDiags){
+    printDiags("Warnings", warnings, maxDiags);
+    printDiags("Semantic Errors", sem.errors, maxDiags);   // continue to print what we have
+
+    if (showTree) {
+        cout << "\n";
+        ASTPrinter(ast, sem).print();
+    }
 
     // DOT
-    DOT dot("annotated_ast.dot");
-    int programNode = dot.node("Program");
-    int idx=1;
-    for (auto& s: program) {
-        int r = dot.emitStmt(*s, sem);
-        dot.edge(programNode, r, "stmt"+to_string(idx++));
-    }
-
-    // If last statement is Print and expr folded, show its computed value
-    if (!program.empty()) {
-        if (auto p = dynamic_cast<Print*>(program.back().get())) {
-            auto A = sem.get(p->expr.get());
-            if (A.type==Type::Int && A.isConst) {
-                cout << "\n=== Evaluation (constant-folded) ===\n";
-                cout << "dekhao(...) = " << A.constVal << "\n";
+    DOT("annotated_ast.dot", ast, sem, dotOpt).program();
+    if (!writeImage("annotated_ast.bin", ast, sem, warnings)) cerr << "Warning: could not write annotated_ast.bin\n";
+
+    if (showIR) {
+        cout << "\n=== IR ===\n";
+        if (!sem.errors.empty()) cout << "(not built: semantic errors)\n";
+        else {
+            IR ir = IR::lower(ast, sem);
+            size_t before = ir.code.size();
+            PassManager pm; pm.run(ir);
+            ir.dump(cout);
+            cout << "\n=== Passes (" << before << " insts in) ===\n";
+            pm.report(cout);
+        }
+    }
+
+    // Run the program
+    cout << "\n=== Evaluation ===\n";
+    if (!sem.errors.empty()) cout << "(not run: semantic errors)\n";
+    else Evaluator(ast, sem).run([&](NodeId s, long long v){ cout << loc(ast,s) << "dekhao(...) = " << v << "\n"; });
+}
+
+// --watch: redo the report whenever input.txt changes, reparsing only the
+// lines that changed. Runs until interrupted.
+static int watch(const DotOptions& dotOpt, bool showTree, bool showIR, size_t maxDiags){
+    Session S;
+    filesystem::file_time_type seen{}; uintmax_t seenSize=uintmax_t(-1);
+    for (;;) {
+        error_code ec;
+        auto t=filesystem::last_write_time("input.txt", ec);
+        uintmax_t sz=ec? 0 : filesystem::file_size("input.txt", ec);
+        SourceFile src;
+        if (!ec && (t!=seen || sz!=seenSize) && src.open("input.txt")) {
+            seen=t; seenSize=sz;
+            if (src.view().size()>=kMaxSourceBytes) { cerr << "Error: input.txt is 4 GB or larger\n"; continue; }
+            auto t0=chrono::steady_clock::now();
+            Session::Stats st=S.update(src.view());
+            auto t1=chrono::steady_clock::now();
+            cout<<"=== Lexical Tokens ===\n";
+            if (S.report(src.view())) emitResults(S.ast, S.sem, S.warnings, dotOpt, showTree, showIR, maxDiags);
+            cout << "\n=== Incremental ===\nreparsed " << st.reparsed << " of " << st.lines << " lines, reanalyzed "
+                 << st.reanalyzed << " nodes in " << chrono::duration<double,milli>(t1-t0).count() << " ms\n" << endl;
+        }
+        this_thread::sleep_for(chrono::milliseconds(200));
+    }
+}
+
+int main(int argc, char** argv){
+    int jobs=1;  // --jobs N: parallel lexing, parsing and analysis (0 = one per core)
+    int bench=-1, benchE=-1, benchI=-1;
+    string inspect;     // --inspect-bin FILE
+    bool showIR=false;  // --ir: lower to SSA, optimize, dump code and pass stats
+    bool showTree=true; // --no-tree: skip the annotated tree dump
+    DotOptions dotOpt;
+    bool watching=false;              // --watch
+    size_t maxDiags=SIZE_MAX;         // --max-diags N: rendered per section
+    bool useCache=true;               // --no-cache
+    uint64_t cacheLimit=256ull<<20;   // --cache-max-mb N
+    for (int a=1; a<argc; ++a) {
+        string arg=argv[a]; bool more=a+1<argc;
+        if (arg=="--bench-analyze" && more) bench=atoi(argv[++a]);
+        if (arg=="--bench-eval" && more) benchE=atoi(argv[++a]);
+        if (arg=="--jobs" && more) { jobs=atoi(argv[++a]); if (jobs<=0) jobs=max(1u, thread::hardware_concurrency()); }
+        if (arg=="--ir") showIR=true;
+        if (arg=="--no-tree") showTree=false;
+        if (arg=="--no-cache") useCache=false;
+        if (arg=="--watch") watching=true;
+        if (arg=="--max-diags" && more) maxDiags=size_t(max(0, atoi(argv[++a])));
+        if (arg=="--bench-incremental" && more) benchI=atoi(argv[++a]);
+        if (arg=="--cache-max-mb" && more) cacheLimit=uint64_t(max(0, atoi(argv[++a])))<<20;
+        if (arg=="--inspect-bin" && more) inspect=argv[++a];
+        if (arg=="--dot-max-depth" && more) dotOpt.maxDepth=atoi(argv[++a]);
+        if (arg=="--dot-max-nodes" && more) dotOpt.maxNodes=size_t(max(0, atoi(argv[++a])));
+        if (arg=="--dot-full") dotOpt.summarize=false;
+        if (arg=="--stmt-range" && more) {   // a:b, either side may be left out
+            string r=argv[++a]; size_t c=r.find(':');
+            if (c==string::npos) dotOpt.first=dotOpt.last=size_t(max(1, atoi(r.c_str())));
+            else {
+                if (c>0) dotOpt.first=size_t(max(1, atoi(r.substr(0,c).c_str())));
+                if (c+1<r.size()) dotOpt.last=size_t(max(0, atoi(r.substr(c+1).c_str())));
             }
         }
     }
+    if (bench>=0) return benchAnalyze(bench, jobs);
+    if (benchE>=0) return benchEval(benchE);
+    if (benchI>=0) return benchIncremental(benchI);
+    if (!inspect.empty()) return inspectImage(inspect);
+    if (watching) return watch(dotOpt, showTree, showIR, maxDiags);
+
+    SourceFile src;
+    if (!src.open("input.txt")){ cerr<<"Error: could not open input.txt\n"; return 1; }
+    if (src.view().size()>=kMaxSourceBytes){ cerr<<"Error: input.txt is 4 GB or larger\n"; return 1; }
 
+    AST ast;
+    Semantic sem(ast);
+    vector<Diagnostic> warnings;
+    vector<Token> tokens;   // non-END tokens, kept for the cache
+    string key = useCache? cacheKey(src.view()) : "";
+    if (!key.empty() && cacheLoad(key, src.view().size(), ast, sem, warnings, tokens)) {
+        cout<<"=== Lexical Tokens ===\n";
+        for (auto& t: tokens) cout<<"Line "<<t.line<<" -> "<<src.view().substr(t.off,t.len)<<"\n";
+    } else {
+        if (jobs>1) {
+            if (!parseParallel(src.view(), jobs, ast, warnings, sem.errors, useCache? &tokens : nullptr)) return 2;
+        } else {
+            Chunk all; all.text = src.view();
+            all.run(ast, atoms);
+            cout<<"=== Lexical Tokens ===\n";
+            if (!all.report()) return 2;
+            warnings = all.lexer.warnings;
+            sem.errors = all.errors;
+            if (useCache) for (auto& t: all.lexer.tokens) if (t.type!=TokType::END) tokens.push_back(t);
+        }
+
+        // Semantic analysis
+        sem.analyze(jobs);
+        if (useCache) cacheStore(key, ast, sem, warnings, tokens, cacheLimit);
+    }
+
+    // Report
+    emitResults(ast, sem, warnings, dotOpt, showTree, showIR, maxDiags);
     return 0;
 }
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 #include <unordered_map>
 #include <regex>
 #include <cctype>
@@ -37,41 +38,86 @@ struct Parser {
         while(i<s.size()&&(isalnum((unsigned char)s[i])||s[i]=='_'))++i;
         return s.substr(st,i-st);
     }
+    // number or variable; parentheses are handled by expr()
     double factor(){
         skip();
-        if(match('(')){double v=expr(); if(!match(')'))throw std::runtime_error("Missing )"); return v;}
         if(i<s.size()&&(isdigit((unsigned char)s[i])||s[i]=='+'||s[i]=='-'))return parse_number();
         std::string id=parse_identifier();
         if(!env->hasVar(id))throw std::runtime_error("Undefined variable: "+id);
         return env->values[id];
     }
-    double term(){
-        double v=factor();
-        while(true){skip();
-            if(match('*'))v*=factor();
-            else if(match('/')){double r=factor(); if(fabs(r)<1e-15)throw std::runtime_error("Division by zero"); v/=r;}
-            else break;
-        }return v;
-    }
+    static int prec(char c){return c=='+'||c=='-'?1:c=='*'||c=='/'?2:0;}
+    // Operator precedence over explicit stacks, so deep nesting cannot
+    // overflow the call stack. A pending operator is applied no later than
+    // the next operator or ')', which is when the recursive version did it,
+    // so errors still come out in the same order.
     double expr(){
-        double v=term();
-        while(true){skip();
-            if(match('+'))v+=term();
-            else if(match('-'))v-=term();
-            else break;
-        }return v;
+        std::vector<double> vals; std::vector<char> ops;   // '(' marks an open group
+        auto reduce=[&]{
+            double r=vals.back(); vals.pop_back(); double& v=vals.back(); char o=ops.back(); ops.pop_back();
+            if(o=='+')v+=r; else if(o=='-')v-=r; else if(o=='*')v*=r;
+            else{if(fabs(r)<1e-15)throw std::runtime_error("Division by zero"); v/=r;}
+        };
+        while(true){
+            while(match('('))ops.push_back('(');
+            vals.push_back(factor());
+            while(true){skip();
+                if(i<s.size()&&prec(s[i])){
+                    char o=s[i++];
+                    while(!ops.empty()&&prec(ops.back())>=prec(o))reduce();
+                    ops.push_back(o); break;
+                }
+                while(!ops.empty()&&ops.back()!='(')reduce();
+                if(ops.empty())return vals.back();
+                if(!match(')'))throw std::runtime_error("Missing )");
+                ops.pop_back();
+            }
+        }
     }
 };
 
 static inline bool is_int_like(double x){return fabs(x-round(x))<1e-9;}
 
+// Same match as ^\s*dekhao\(\s*(.+)\s*\)\s*$ but in one scan; std::regex
+// recurses per character and overflows on very long (deeply nested) lines.
+static bool match_print(const std::string& line, std::string& args){
+    size_t b=0, e=line.size();
+    while(b<e&&isspace((unsigned char)line[b]))++b;
+    while(e>b&&isspace((unsigned char)line[e-1]))--e;
+    if(line.compare(b,7,"dekhao(")!=0)return false;
+    b+=7;
+    if(e<=b||line[e-1]!=')')return false;
+    --e;
+    // (.+) takes no line breaks and the \s* around it soak up the rest
+    auto brk=[](char c){return c=='\r'||c=='\n';};
+    size_t f=b, l=e;
+    while(f<e&&isspace((unsigned char)line[f]))++f;
+    if(f==e){   // blank: matches if one char can stand in for (.+)
+        while(l>b&&brk(line[l-1]))--l;
+        if(l==b)return false;
+        args=line.substr(l-1,1);
+        return true;
+    }
+    while(isspace((unsigned char)line[l-1]))--l;
+    for(size_t k=f;k<l;++k)if(brk(line[k]))return false;
+    while(l<e&&!brk(line[l]))++l;
+    args=line.substr(f,l-f);
+    return true;
+}
+
+static std::string trim(const std::string& s){
+    size_t b=0, e=s.size();
+    while(b<e&&isspace((unsigned char)s[b]))++b;
+    while(e>b&&isspace((unsigned char)s[e-1]))--e;
+    return s.substr(b,e-b);
+}
+
 int main(){
     std::ifstream f("editor.txt");
     if(!f.is_open()){std::cerr<<"Cannot open editor.txt\n";return 1;}
     Env env; std::string line;
 
     std::regex decl(R"(^\s*(integer|float)\s+([A-Za-z_]\w*)\s+te\s+(-?\d+(?:\.\d+)?)\s*$)");
-    std::regex print_re(R"(^\s*dekhao\(\s*(.+)\s*\)\s*$)");
 
     while(std::getline(f,line)){
         if(line.empty())continue;
@@ -84,15 +130,15 @@ int main(){
             continue;
         }
         // print
-        if(std::regex_match(line,m,print_re)){
-            std::string args=m[1];
+        std::string args;
+        if(match_print(line,args)){
             // split by commas not inside quotes
             bool in_str=false; std::string token;
             for(size_t i=0;i<=args.size();++i){
                 if(i==args.size()||(!in_str&&args[i]==',')){
                     std::string part=token; token.clear();
                     // trim
-                    part=std::regex_replace(part,std::regex(R"(^\s+|\s+$)"),"");
+                    part=trim(part);
                     if(!part.empty()){
                         if(part.size()>=2&&part.front()=='"'&&part.back()=='"'){
                             std::string text=part.substr(1,part.size()-2);
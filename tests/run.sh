@@ -0,0 +1,37 @@
+#!/bin/sh
+# Runs the cases under tests/<program>/<case>/. Each case directory is
+# copied into a scratch directory, its `run` script is executed there, and
+# what that prints on stdout must match its `expected` file byte for byte.
+# Inside `run`, $T is the Class 2 transpiler and $C3 the class3 front end.
+# Usage: sh tests/run.sh [substring of case names]   (needs g++ and cc)
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+bin=$(mktemp -d)
+trap 'rm -rf "$bin"' EXIT
+g++ -std=c++17 -O2 -o "$bin/transpiler" "$root/Class 2/main.cpp"
+g++ -std=c++17 -O2 -pthread -o "$bin/class3" "$root/class3/main.cpp"
+T=$bin/transpiler
+C3=$bin/class3
+export T C3
+
+pass=0
+fail=0
+for dir in "$root"/tests/*/*/; do
+    name=${dir#"$root/tests/"}
+    name=${name%/}
+    case $name in *"${1:-}"*) ;; *) continue ;; esac
+    work=$bin/work
+    rm -rf "$work"
+    cp -R "$dir" "$work"
+    if (cd "$work" && sh ./run > "$bin/actual" 2> "$bin/stderr") && cmp -s "$dir/expected" "$bin/actual"; then
+        pass=$((pass + 1))
+        echo "ok   $name"
+    else
+        fail=$((fail + 1))
+        echo "FAIL $name"
+        diff "$dir/expected" "$bin/actual" || true
+        sed 's/^/  stderr: /' "$bin/stderr"
+    fi
+done
+echo "$pass passed, $fail failed"
+[ "$fail" -eq 0 ]